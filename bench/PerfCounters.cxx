@@ -0,0 +1,125 @@
+/**
+ * PerfCounters class implementation
+ *
+ * @file PerfCounters.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "PerfCounters.hxx"
+
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* Helper functions ------------------------------------ */
+static int openEvent(const std::uint32_t &pType, const std::uint64_t &pConfig)
+{
+    perf_event_attr lAttr;
+
+    std::memset(&lAttr, 0, sizeof(lAttr));
+    lAttr.size           = sizeof(lAttr);
+    lAttr.type           = pType;
+    lAttr.config         = pConfig;
+    lAttr.disabled       = 1;
+    lAttr.inherit        = 1; /* Count the threads created afterwards */
+    lAttr.exclude_hv     = 1;
+
+    // Context switches happen in the kernel, hardware
+    // events are only counted in user space
+    lAttr.exclude_kernel = (PERF_TYPE_SOFTWARE == pType) ? 0 : 1;
+
+    // This process, any CPU
+    return static_cast<int>(syscall(SYS_perf_event_open, &lAttr, 0, -1, -1, 0));
+}
+
+/* PerfCounters implementation ------------------------- */
+PerfCounters::PerfCounters()
+{
+    fds[CYCLES]           = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[INSTRUCTIONS]     = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[CACHE_MISSES]     = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[BRANCH_MISSES]    = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    fds[CONTEXT_SWITCHES] = openEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+
+    values.fill(0U);
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (const int &lFd : fds) {
+        if (0 <= lFd) {
+            close(lFd);
+        }
+    }
+}
+
+void PerfCounters::start()
+{
+    for (const int &lFd : fds) {
+        if (0 <= lFd) {
+            ioctl(lFd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(lFd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop()
+{
+    for (std::size_t i = 0U; i < EVENT_COUNT; ++i) {
+        values[i] = 0U;
+
+        if (0 > fds[i]) {
+            continue;
+        }
+
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+        // With inherit set, the value includes the
+        // threads that exited since start()
+        if (sizeof(values[i]) != read(fds[i], &values[i], sizeof(values[i]))) {
+            values[i] = 0U;
+        }
+    }
+}
+
+bool PerfCounters::available(const Event &pEvent) const noexcept
+{
+    return 0 <= fds[pEvent];
+}
+
+bool PerfCounters::available() const noexcept
+{
+    for (const int &lFd : fds) {
+        if (0 <= lFd) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::uint64_t PerfCounters::value(const Event &pEvent) const noexcept
+{
+    return values[pEvent];
+}
+
+const char *PerfCounters::name(const Event &pEvent) noexcept
+{
+    switch (pEvent) {
+        case CYCLES:
+            return "cycles";
+        case INSTRUCTIONS:
+            return "instructions";
+        case CACHE_MISSES:
+            return "cache-misses";
+        case BRANCH_MISSES:
+            return "branch-misses";
+        case CONTEXT_SWITCHES:
+            return "ctx-switches";
+        default:
+            return "unknown";
+    }
+}
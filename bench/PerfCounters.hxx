@@ -0,0 +1,75 @@
+/**
+ * PerfCounters class definition
+ *
+ * @file PerfCounters.hxx
+ */
+
+#ifndef PERFCOUNTERS_HXX
+#define PERFCOUNTERS_HXX
+
+/* Includes -------------------------------------------- */
+#include <array>
+#include <string>
+
+#include <cstdint>
+#include <cstddef>
+
+/* PerfCounters class definition ----------------------- */
+/** @brief Hardware and software performance counters
+ * of the calling process, read with perf_event_open
+ *
+ * The counters are inherited by the threads created after
+ * start(), which includes a TimerThread worker started by
+ * the measured scenario.
+ *
+ * Counters that can't be opened (no PMU, restrictive
+ * perf_event_paranoid, seccomp, ...) are reported as
+ * unavailable and the others keep working.
+ */
+class PerfCounters
+{
+    public:
+        /** @brief Counted events */
+        enum Event {
+            CYCLES = 0,
+            INSTRUCTIONS,
+            CACHE_MISSES,
+            BRANCH_MISSES,
+            CONTEXT_SWITCHES,
+            EVENT_COUNT
+        };
+
+        /** @brief Constructor opens the counters, disabled */
+        explicit PerfCounters();
+
+        /** @brief Destructor closes the counters */
+        ~PerfCounters();
+
+        // Never called
+        PerfCounters(PerfCounters const &r)            = delete;
+        PerfCounters &operator=(PerfCounters const &r) = delete;
+
+        /** @brief Reset and enable the counters */
+        void start();
+
+        /** @brief Disable the counters and read their values */
+        void stop();
+
+        /** @brief Whether an event could be opened */
+        bool available(const Event &pEvent) const noexcept;
+
+        /** @brief Whether at least one event could be opened */
+        bool available() const noexcept;
+
+        /** @brief Value read by the last stop() */
+        std::uint64_t value(const Event &pEvent) const noexcept;
+
+        /** @brief Name of an event, for reports */
+        static const char *name(const Event &pEvent) noexcept;
+
+    private:
+        std::array<int, EVENT_COUNT>           fds;
+        std::array<std::uint64_t, EVENT_COUNT> values;
+};
+
+#endif /* PERFCOUNTERS_HXX */
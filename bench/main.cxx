@@ -0,0 +1,479 @@
+/**
+ * TimerThread benchmark suite
+ *
+ * @file main.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "TimerThread.hxx"
+#include "TimerBatch.hxx"
+#include "TimerDomain.hxx"
+#include "MultiQueue.hxx"
+#include "PerfCounters.hxx"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <numeric>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+
+/* Benchmark options ----------------------------------- */
+struct Options {
+    std::size_t ops       = 100000U;
+    std::size_t producers = 4U;
+    std::size_t choices   = TIMER_MULTIQUEUE_CHOICES;
+    bool        perf      = false;
+    bool        sweep     = false;
+    const char *scenario  = nullptr;
+};
+
+/* Scenarios ------------------------------------------- */
+// Each scenario creates and destroys its own TimerThread, so
+// that its worker's counters are accumulated by PerfCounters.
+// It returns the number of operations it performed. The scenarios
+// measuring the order in which the timers are popped set sRankError
+
+static double sRankError = -1.0;
+
+// Operations of each producer, at least one so that every
+// producer runs, and no scenario is left without operations
+static std::size_t perProducer(const Options &pOptions)
+{
+    return std::max<std::size_t>(pOptions.ops / pOptions.producers, 1U);
+}
+
+static std::size_t addClear(const Options &pOptions)
+{
+    TimerThread                          lTimers;
+    std::vector<TimerThread::timer_id_t> lIds(pOptions.ops);
+
+    // Far deadlines, the timers never fire
+    for (std::size_t i = 0U; i < pOptions.ops; ++i) {
+        lIds[i] = lTimers.setTimeout([]() {}, 60 * 1000 * 1000);
+    }
+
+    for (const TimerThread::timer_id_t &lId : lIds) {
+        lTimers.clearTimer(lId);
+    }
+
+    return 2U * pOptions.ops;
+}
+
+// Same as addClear, with the operations published
+// TIMER_BATCH_SIZE at a time by a TimerBatch
+static std::size_t addClearBatch(const Options &pOptions)
+{
+    TimerThread                          lTimers;
+    std::vector<TimerThread::timer_id_t> lIds(pOptions.ops);
+
+    {
+        TimerBatch lBatch(TIMER_BATCH_SIZE, 0, lTimers);
+
+        for (std::size_t i = 0U; i < pOptions.ops; ++i) {
+            lIds[i] = lBatch.setTimeout([]() {}, 60 * 1000 * 1000);
+        }
+
+        lBatch.flush();
+
+        for (const TimerThread::timer_id_t &lId : lIds) {
+            lBatch.clearTimer(lId);
+        }
+    }
+
+    return 2U * pOptions.ops;
+}
+
+static std::size_t fire(const Options &pOptions)
+{
+    TimerThread              lTimers;
+    std::atomic<std::size_t> lFired(0U);
+
+    for (std::size_t i = 0U; i < pOptions.ops; ++i) {
+        lTimers.setTimeout([&lFired]() {
+                                lFired.fetch_add(1U, std::memory_order_relaxed);
+                            },
+                            0);
+    }
+
+    while (lFired.load(std::memory_order_relaxed) < pOptions.ops) {
+        std::this_thread::yield();
+    }
+
+    return pOptions.ops;
+}
+
+// Producers hammering the TimerThread's lock, with the given lock policy
+template<TimerThread::LockPolicy POLICY>
+static std::size_t contention(const Options &pOptions)
+{
+    TimerThread              lTimers(POLICY);
+    std::vector<std::thread> lProducers;
+    std::size_t const        lPerProducer = perProducer(pOptions);
+
+    for (std::size_t p = 0U; p < pOptions.producers; ++p) {
+        lProducers.emplace_back([&lTimers, lPerProducer]() {
+                                    for (std::size_t i = 0U; i < lPerProducer; ++i) {
+                                        lTimers.clearTimer(lTimers.setTimeout([]() {}, 60 * 1000 * 1000));
+                                    }
+                                });
+    }
+
+    for (std::thread &lProducer : lProducers) {
+        lProducer.join();
+    }
+
+    return 2U * lPerProducer * pOptions.producers;
+}
+
+// Producers hammering the TimerThread, which applies their
+// operations by flat combining
+static std::size_t contentionCombining(const Options &pOptions)
+{
+    TimerThread              lTimers;
+    std::vector<std::thread> lProducers;
+    std::size_t const        lPerProducer = perProducer(pOptions);
+
+    lTimers.setFlatCombining(true);
+
+    for (std::size_t p = 0U; p < pOptions.producers; ++p) {
+        lProducers.emplace_back([&lTimers, lPerProducer]() {
+                                    for (std::size_t i = 0U; i < lPerProducer; ++i) {
+                                        lTimers.clearTimer(lTimers.setTimeout([]() {}, 60 * 1000 * 1000));
+                                    }
+                                });
+    }
+
+    for (std::thread &lProducer : lProducers) {
+        lProducer.join();
+    }
+
+    return 2U * lPerProducer * pOptions.producers;
+}
+
+// Producers hammering the TimerThread with the given queue backend
+template<TimerThread::QueueBackend BACKEND>
+static std::size_t contentionBackend(const Options &pOptions)
+{
+    TimerThread              lTimers;
+    std::vector<std::thread> lProducers;
+    std::size_t const        lPerProducer = perProducer(pOptions);
+
+    lTimers.setQueueBackend(BACKEND);
+
+    for (std::size_t p = 0U; p < pOptions.producers; ++p) {
+        lProducers.emplace_back([&lTimers, lPerProducer]() {
+                                    for (std::size_t i = 0U; i < lPerProducer; ++i) {
+                                        lTimers.clearTimer(lTimers.setTimeout([]() {}, 60 * 1000 * 1000));
+                                    }
+                                });
+    }
+
+    for (std::thread &lProducer : lProducers) {
+        lProducer.join();
+    }
+
+    return 2U * lPerProducer * pOptions.producers;
+}
+
+// Producers inserting entries due in a random order into a
+// MultiQueue, sized like the one of the MultiQueue backend, which
+// is popped with `choices` heads compared, in rounds 1 ms apart of
+// simulated time, like a worker waking up every millisecond.
+// sRankError is the mean number of entries still in the queue when
+// each entry was popped, though they were due before it. The order
+// of the handlers is not measured, the worker fires them through
+// its tree in exact order
+static std::size_t order(const Options &pOptions)
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::uint64_t     id = 0U;
+        Clock::time_point next;
+    };
+
+    std::size_t const              lThreads = std::max(std::thread::hardware_concurrency(), 1U);
+    MultiQueue<Entry>              lQueue(TIMER_MULTIQUEUE_FACTOR * lThreads);
+    std::vector<std::thread>       lProducers;
+    std::size_t const              lCount = perProducer(pOptions) * pOptions.producers;
+    Clock::time_point const        lBase  = Clock::now();
+    std::vector<Clock::time_point> lDue(lCount);
+    std::vector<std::size_t>       lPopped;
+
+    lPopped.reserve(lCount);
+
+    for (std::size_t p = 0U; p < pOptions.producers; ++p) {
+        lProducers.emplace_back([&, p]() {
+                                    std::uint32_t lSeed = static_cast<std::uint32_t>(p + 1U) * 2654435761U;
+
+                                    for (std::size_t i = p; i < lCount; i += pOptions.producers) {
+                                        // 10 to 30 ms, in steps of 10 us
+                                        lDue[i] = lBase + std::chrono::microseconds(10000 + ((lSeed >> 8U) % 2000U) * 10);
+                                        lSeed   = lSeed * 1664525U + 1013904223U;
+
+                                        lQueue.insert(Entry{i, lDue[i]});
+                                    }
+                                });
+    }
+
+    for (std::thread &lProducer : lProducers) {
+        lProducer.join();
+    }
+
+    for (Clock::time_point lNow = lBase; lPopped.size() < lCount; lNow += std::chrono::milliseconds(1)) {
+        lQueue.pop(lNow, pOptions.choices, [&lPopped](Entry &&pEntry) {
+                                                lPopped.push_back(static_cast<std::size_t>(pEntry.id));
+                                            });
+    }
+
+    // Rank of each entry by deadline
+    std::vector<std::size_t>       lByDue(lCount);
+    std::vector<std::size_t>       lRank(lCount);
+    std::vector<Clock::time_point> lSorted(lCount);
+
+    std::iota(lByDue.begin(), lByDue.end(), 0U);
+    std::sort(lByDue.begin(), lByDue.end(),
+                [&lDue](std::size_t a, std::size_t b) {
+                    return lDue[a] < lDue[b];
+                });
+
+    for (std::size_t r = 0U; r < lCount; ++r) {
+        lRank[lByDue[r]] = r;
+        lSorted[r]       = lDue[lByDue[r]];
+    }
+
+    // Fenwick tree of the entries still in the queue, by rank
+    std::vector<std::size_t> lPending(lCount + 1U, 0U);
+    double                   lErrors = 0.0;
+
+    for (std::size_t r = 1U; r <= lCount; ++r) {
+        for (std::size_t j = r; j <= lCount; j += j & (~j + 1U)) {
+            ++lPending[j];
+        }
+    }
+
+    for (std::size_t const &lIndex : lPopped) {
+        // Entries left that are due strictly before this one
+        std::size_t const lBefore = static_cast<std::size_t>(std::lower_bound(lSorted.begin(), lSorted.end(), lDue[lIndex])
+                                                              - lSorted.begin());
+
+        for (std::size_t j = lBefore; j > 0U; j -= j & (~j + 1U)) {
+            lErrors += static_cast<double>(lPending[j]);
+        }
+
+        for (std::size_t j = lRank[lIndex] + 1U; j <= lCount; j += j & (~j + 1U)) {
+            --lPending[j];
+        }
+    }
+
+    sRankError = lErrors / static_cast<double>(lCount);
+
+    return lCount;
+}
+
+// Producers hammering their own TimerThread of a TimerDomain, which
+// shards the timers, and their lock, across as many workers
+static std::size_t contentionDomain(const Options &pOptions)
+{
+    TimerDomain              lDomain(pOptions.producers);
+    std::vector<std::thread> lProducers;
+    std::size_t const        lPerProducer = perProducer(pOptions);
+
+    for (std::size_t p = 0U; p < pOptions.producers; ++p) {
+        lProducers.emplace_back([&lDomain, lPerProducer]() {
+                                    TimerThread lTimers(lDomain);
+
+                                    for (std::size_t i = 0U; i < lPerProducer; ++i) {
+                                        lTimers.clearTimer(lTimers.setTimeout([]() {}, 60 * 1000 * 1000));
+                                    }
+                                });
+    }
+
+    for (std::thread &lProducer : lProducers) {
+        lProducer.join();
+    }
+
+    return 2U * lPerProducer * pOptions.producers;
+}
+
+struct Scenario {
+    const char *name;
+    std::size_t (*run)(const Options &);
+};
+
+static const Scenario sScenarios[] = {
+    {"add-clear",              addClear},
+    {"add-clear-batch",        addClearBatch},
+    {"fire",                   fire},
+    {"contention",             contention<TimerThread::LockPolicy::Blocking>},
+    {"contention-spin",        contention<TimerThread::LockPolicy::AdaptiveSpin>},
+    {"contention-pi",          contention<TimerThread::LockPolicy::PriorityInheritance>},
+    {"contention-combining",   contentionCombining},
+    {"contention-wheel",       contentionBackend<TimerThread::QueueBackend::Wheel>},
+    {"contention-cwheel",      contentionBackend<TimerThread::QueueBackend::ConcurrentWheel>},
+    {"contention-skiplist",    contentionBackend<TimerThread::QueueBackend::SkipList>},
+    {"contention-multiqueue",  contentionBackend<TimerThread::QueueBackend::MultiQueue>},
+    {"contention-localheaps",  contentionBackend<TimerThread::QueueBackend::LocalHeaps>},
+    {"contention-domain",      contentionDomain},
+    {"order-multiqueue",       order},
+};
+
+/* Report ---------------------------------------------- */
+static void printHeader(const PerfCounters *pCounters)
+{
+    std::cout << std::left << std::setw(24) << "scenario"
+              << std::right << std::setw(12) << "ops"
+              << std::setw(12) << "ns/op"
+              << std::setw(12) << "rank err";
+
+    if (nullptr != pCounters) {
+        for (int e = 0; e < PerfCounters::EVENT_COUNT; ++e) {
+            std::cout << std::setw(16) << PerfCounters::name(static_cast<PerfCounters::Event>(e));
+        }
+    }
+
+    std::cout << std::endl;
+}
+
+static void printResult(const char         *pName,
+                        const std::size_t  &pOps,
+                        const double       &pNs,
+                        const PerfCounters *pCounters)
+{
+    std::cout << std::left << std::setw(24) << pName
+              << std::right << std::setw(12) << pOps
+              << std::setw(12) << std::fixed << std::setprecision(1) << (pNs / static_cast<double>(pOps));
+
+    if (0.0 <= sRankError) {
+        std::cout << std::setw(12) << std::setprecision(3) << sRankError;
+    } else {
+        std::cout << std::setw(12) << "-";
+    }
+
+    if (nullptr != pCounters) {
+        // Counters are reported per operation
+        for (int e = 0; e < PerfCounters::EVENT_COUNT; ++e) {
+            PerfCounters::Event const lEvent = static_cast<PerfCounters::Event>(e);
+
+            if (pCounters->available(lEvent)) {
+                std::cout << std::setw(16) << std::setprecision(3)
+                          << (static_cast<double>(pCounters->value(lEvent)) / static_cast<double>(pOps));
+            } else {
+                std::cout << std::setw(16) << "n/a";
+            }
+        }
+    }
+
+    std::cout << std::endl;
+}
+
+static void usage(const char *pName)
+{
+    std::cout << "Usage : " << pName << " [--perf] [--ops <n>] [--producers <n>] [--choices <n>] [--sweep] [--scenario <name>]" << std::endl
+              << "  --perf      Read perf_event_open counters around each scenario" << std::endl
+              << "  --ops       Operations per scenario (default 100000)" << std::endl
+              << "  --producers Producer threads of the contention scenarios (default 4)" << std::endl
+              << "  --choices   Heaps compared per pop by the MultiQueue backend (default " << TIMER_MULTIQUEUE_CHOICES << ")" << std::endl
+              << "  --sweep     Run the contention scenarios with 1 to 64 producers" << std::endl
+              << "  --scenario  Only run this scenario" << std::endl;
+}
+
+/* Main ------------------------------------------------ */
+int main(const int argc, const char * const * const argv)
+{
+    Options lOptions;
+
+    for (int i = 1; i < argc; ++i) {
+        if (0 == std::strcmp(argv[i], "--perf")) {
+            lOptions.perf = true;
+        } else if (0 == std::strcmp(argv[i], "--sweep")) {
+            lOptions.sweep = true;
+        } else if ((0 == std::strcmp(argv[i], "--ops")) && (i + 1 < argc)) {
+            lOptions.ops = std::strtoul(argv[++i], nullptr, 10);
+        } else if ((0 == std::strcmp(argv[i], "--producers")) && (i + 1 < argc)) {
+            lOptions.producers = std::strtoul(argv[++i], nullptr, 10);
+
+            // Each scenario divides the operations among the producers
+            if (0U == lOptions.producers) {
+                std::cerr << "[ERROR] <TimerThread-bench> --producers needs at least 1 producer" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if ((0 == std::strcmp(argv[i], "--choices")) && (i + 1 < argc)) {
+            lOptions.choices = std::strtoul(argv[++i], nullptr, 10);
+        } else if ((0 == std::strcmp(argv[i], "--scenario")) && (i + 1 < argc)) {
+            lOptions.scenario = argv[++i];
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (0U == lOptions.ops) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    PerfCounters  lCounters;
+    PerfCounters *lReported = nullptr;
+
+    if (lOptions.perf) {
+        if (lCounters.available()) {
+            lReported = &lCounters;
+        } else {
+            std::cerr << "[WARN ] <TimerThread-bench> perf events are unavailable, "
+                      << "check /proc/sys/kernel/perf_event_paranoid" << std::endl;
+        }
+    }
+
+    printHeader(lReported);
+
+    for (const Scenario &lScenario : sScenarios) {
+        if ((nullptr != lOptions.scenario) && (0 != std::strcmp(lOptions.scenario, lScenario.name))) {
+            continue;
+        }
+
+        // The contention scenarios are swept over the number of
+        // producers, reported as <scenario>/<producers>
+        bool const  lSweep = lOptions.sweep && (0 == std::strncmp(lScenario.name, "contention", 10));
+        std::size_t lFirst = lSweep ? 1U : lOptions.producers;
+        std::size_t lLast  = lSweep ? 64U : lOptions.producers;
+
+        for (std::size_t lProducers = lFirst; lProducers <= lLast; lProducers *= 2U) {
+            Options lRun = lOptions;
+
+            lRun.producers = lProducers;
+
+            if (nullptr != lReported) {
+                lReported->start();
+            }
+
+            sRankError = -1.0;
+
+            auto const        lStart = std::chrono::steady_clock::now();
+            std::size_t const lOps   = lScenario.run(lRun);
+            auto const        lEnd   = std::chrono::steady_clock::now();
+
+            if (nullptr != lReported) {
+                lReported->stop();
+            }
+
+            std::string const lName = lSweep ? std::string(lScenario.name) + "/" + std::to_string(lProducers)
+                                             : std::string(lScenario.name);
+
+            printResult(lName.c_str(),
+                        lOps,
+                        static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(lEnd - lStart).count()),
+                        lReported);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
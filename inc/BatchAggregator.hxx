@@ -0,0 +1,250 @@
+/**
+ * BatchAggregator class definition
+ *
+ * @file BatchAggregator.hxx
+ */
+
+#ifndef BATCHAGGREGATOR_HXX
+#define BATCHAGGREGATOR_HXX
+
+/* Includes -------------------------------------------- */
+#include "TimerThread.hxx"
+
+#include <functional>
+#include <chrono>
+#include <vector>
+#include <mutex>
+
+#include <cstddef>
+
+/* BatchAggregator class definition -------------------- */
+/** @brief Time-or-size batching aggregator
+ *
+ * Items are accumulated in a batch that is flushed either
+ * when it holds `maxItems` items, or `maxDelay` microseconds
+ * after its first item was added, whichever comes first.
+ *
+ * Each aggregator has at most one pending timer on its
+ * TimerThread. It is armed by the first item of a batch, and a
+ * size flush does not disarm it, so it never touches the
+ * TimerThread. When a timer armed for a previous batch fires,
+ * it reschedules itself for the deadline of the current batch
+ * if there is one. This keeps the TimerThread's load low with
+ * thousands of aggregators flushing on size.
+ *
+ * Flushes are serialized, so batches are handed over in order.
+ * The flush handler must not add items to its own aggregator.
+ */
+template<typename T>
+class BatchAggregator
+{
+    public:
+        /* Defining the microsecond type */
+        using time_us_t = TimerThread::time_us_t;
+
+        /* Defining the flush handler type
+         * Called with the batch, which is cleared once it returns
+         */
+        using flush_handler_type = std::function<void(std::vector<T> &)>;
+
+        /** @brief Constructor does not arm any timer until the first item */
+        explicit BatchAggregator(std::size_t        maxItems,
+                                    time_us_t          maxDelay,
+                                    flush_handler_type handler,
+                                    TimerThread       &timerThread = TimerThread::global());
+
+        /** @brief Destructor disarms the timer and flushes
+         * the pending items, if any
+         */
+        ~BatchAggregator();
+
+        // Never called
+        BatchAggregator(BatchAggregator const &r)            = delete;
+        BatchAggregator &operator=(BatchAggregator const &r) = delete;
+
+        /** @brief Add an item to the current batch
+         * Flushes the batch from the calling thread if it is full
+         */
+        void add(T item);
+
+        /** @brief Flush the current batch right away */
+        void flush();
+
+        /* Peek at current state */
+        std::size_t size() const noexcept;
+
+    private:
+        /* Type definitions */
+        using Lock       = std::mutex;
+        using ScopedLock = std::unique_lock<Lock>;
+
+        using Clock     = std::chrono::steady_clock;
+        using Timestamp = std::chrono::time_point<Clock>;
+        using Duration  = std::chrono::microseconds;
+
+        void arm(Duration delay);
+        void expired();
+        void flush_impl(ScopedLock &lock);
+
+        std::size_t const maxItems;
+        Duration const    maxDelay;
+
+        flush_handler_type handler;
+
+        // Current batch, and when its first item was added
+        std::vector<T> batch;
+        Timestamp      first;
+
+        // Batch being flushed, its capacity is reused
+        // by the next batch
+        std::vector<T> flushed;
+
+        // Pending timer, if armed
+        TimerThread            &timerThread;
+        TimerThread::timer_id_t timer;
+        bool                    armed;
+        bool                    closing;
+
+        // `flushSync` is taken with `sync` held,
+        // never the other way around
+        mutable Lock sync;
+        Lock         flushSync;
+};
+
+/* Template implementation of class methods */
+template<typename T>
+BatchAggregator<T>::BatchAggregator(std::size_t        maxItems,
+                                    time_us_t          maxDelay,
+                                    flush_handler_type handler,
+                                    TimerThread       &timerThread)
+    : maxItems(maxItems > 0U ? maxItems : 1U),
+    maxDelay(maxDelay),
+    handler(std::move(handler)),
+    timerThread(timerThread),
+    timer(TimerThread::no_timer),
+    armed(false),
+    closing(false)
+{
+    batch.reserve(this->maxItems);
+}
+
+template<typename T>
+BatchAggregator<T>::~BatchAggregator()
+{
+    ScopedLock lock(sync);
+
+    // The timer does not rearm itself anymore
+    closing = true;
+
+    TimerThread::timer_id_t pending = armed ? timer : TimerThread::no_timer;
+
+    lock.unlock();
+
+    // Synchronizes with the timer's handler if it is running
+    if (TimerThread::no_timer != pending) {
+        timerThread.clearTimer(pending);
+    }
+
+    lock.lock();
+
+    if (!batch.empty()) {
+        flush_impl(lock);
+    }
+}
+
+template<typename T>
+void BatchAggregator<T>::add(T item)
+{
+    ScopedLock lock(sync);
+
+    batch.push_back(std::move(item));
+
+    if (1U == batch.size()) {
+        first = Clock::now();
+
+        // A timer armed for a previous batch fires earlier
+        // than this batch's deadline, it rearms itself then
+        if (!armed) {
+            arm(maxDelay);
+        }
+    }
+
+    if (batch.size() >= maxItems) {
+        flush_impl(lock);
+    }
+}
+
+template<typename T>
+void BatchAggregator<T>::flush()
+{
+    ScopedLock lock(sync);
+
+    if (!batch.empty()) {
+        flush_impl(lock);
+    }
+}
+
+template<typename T>
+std::size_t BatchAggregator<T>::size() const noexcept
+{
+    ScopedLock lock(sync);
+
+    return batch.size();
+}
+
+// NOTE: called with `sync` held
+template<typename T>
+void BatchAggregator<T>::arm(Duration delay)
+{
+    timer = timerThread.setTimeout([this]() {
+                                        expired();
+                                    },
+                                    delay.count());
+    armed = true;
+}
+
+template<typename T>
+void BatchAggregator<T>::expired()
+{
+    ScopedLock lock(sync);
+
+    armed = false;
+
+    if (batch.empty() || closing) {
+        return;
+    }
+
+    Timestamp const now = Clock::now();
+    Timestamp const due = first + maxDelay;
+
+    if (now >= due) {
+        flush_impl(lock);
+    } else {
+        // Armed for a batch that was flushed on size,
+        // follow the current batch instead
+        arm(std::chrono::duration_cast<Duration>(due - now));
+    }
+}
+
+// NOTE: returns with the lock held, but releases
+// it while the flush handler is running
+template<typename T>
+void BatchAggregator<T>::flush_impl(ScopedLock &lock)
+{
+    // Taking `flushSync` before releasing `sync`
+    // keeps the batches in order
+    ScopedLock flushLock(flushSync);
+
+    flushed.swap(batch);
+    batch.reserve(maxItems);
+
+    lock.unlock();
+
+    handler(flushed);
+    flushed.clear();
+
+    flushLock.unlock();
+    lock.lock();
+}
+
+#endif /* BATCHAGGREGATOR_HXX */
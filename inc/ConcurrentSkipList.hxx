@@ -0,0 +1,606 @@
+/**
+ * ConcurrentSkipList class definition
+ *
+ * @file ConcurrentSkipList.hxx
+ */
+
+#ifndef CONCURRENTSKIPLIST_HXX
+#define CONCURRENTSKIPLIST_HXX
+
+/* Includes -------------------------------------------- */
+#include "TimerLock.hxx"
+
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include <cstdint>
+#include <cstddef>
+
+/* Defines --------------------------------------------- */
+#ifndef TIMER_SKIPLIST_LEVELS
+#define TIMER_SKIPLIST_LEVELS 20 /* Levels of the skip list, enough for about 2^TIMER_SKIPLIST_LEVELS timers */
+#endif /* TIMER_SKIPLIST_LEVELS */
+
+#ifndef TIMER_CONCURRENT_SHARDS
+#define TIMER_CONCURRENT_SHARDS 64 /* Independently locked shards of the ID index */
+#endif /* TIMER_CONCURRENT_SHARDS */
+
+/* ConcurrentSkipList class definition ----------------- */
+/** @brief Lock-free skip list shared by many producers and one consumer
+ *
+ * The entries are sorted by (`next`, `id`). Insertions and removals
+ * follow the lock-free skip list of Herlihy and Shavit: a node is
+ * logically deleted by marking its links, top level first, and the
+ * thread that marks its bottom link owns it. Marked nodes are then
+ * unlinked by the next traversals going past them.
+ *
+ * Any thread can take an entry out by ID, the consumer pops the
+ * entries that are due. Only the lookup of a node by ID goes through
+ * an index sharded behind TimerSpinLocks.
+ *
+ * Removed nodes are freed by the consumer, once no traversal that
+ * could still see them is in progress. Traversals register in one of
+ * two reader counters, selected by the parity of an epoch that the
+ * consumer increments once the readers of the previous epoch left.
+ * A node is retired once both its inserter and its remover let go
+ * of it, since the inserter may still link an upper level of a node
+ * removed meanwhile.
+ *
+ * T must be default constructible, movable, and have an `id`
+ * (unique) and a `next` (std::chrono::time_point) member.
+ */
+template<typename T>
+class ConcurrentSkipList
+{
+    public:
+        using id_type   = decltype(T::id);
+        using Timestamp = decltype(T::next);
+
+        explicit ConcurrentSkipList();
+
+        /** @brief Destructor frees all the nodes, there must
+         * not be any other user of the skip list left
+         */
+        ~ConcurrentSkipList();
+
+        // Never called
+        ConcurrentSkipList(ConcurrentSkipList const &r)            = delete;
+        ConcurrentSkipList &operator=(ConcurrentSkipList const &r) = delete;
+
+        /** @brief Insert an entry, from any thread */
+        void insert(T &&entry);
+
+        /** @brief Take an entry out before it is popped, from any thread
+         *
+         * @return false if there is no such entry
+         */
+        bool take(id_type id, T &entry);
+
+        /** @brief Pop the entries due at `now`, consumer only
+         * `fn` is called with each of them, in order
+         */
+        template<typename F>
+        void pop(Timestamp now, F fn);
+
+        /** @brief Free the nodes nobody can see anymore, consumer only */
+        void reclaim();
+
+        /** @brief Deadline of the first entry, Timestamp::max() if empty */
+        Timestamp next();
+
+        /** @brief Drop all the entries */
+        void clear();
+
+        /* Peek at current state */
+        std::size_t size() const;
+
+    private:
+        using ScopedLock = std::unique_lock<TimerSpinLock>;
+        using Link       = std::uintptr_t; /* Pointer to the next Node, marked by its lowest bit */
+
+        struct Node {
+            Timestamp         due;
+            id_type           id;
+            int               levels;
+            T                 entry;
+            std::atomic<bool> linked;   /* Set once inserted at the bottom level */
+            std::atomic<int>  holds;    /* Inserter and remover, the last one to let go retires it */
+            Node             *retired;  /* Next node retired in the same epoch */
+            std::atomic<Link> links[TIMER_SKIPLIST_LEVELS];
+        };
+
+        struct alignas(64) Shard {
+            TimerSpinLock                      sync;
+            std::unordered_map<id_type, Node *> nodes;
+        };
+
+        struct alignas(64) Readers {
+            std::atomic<std::size_t> count;
+        };
+
+        // Registers a traversal for the duration of its scope
+        class ReadGuard
+        {
+            public:
+                explicit ReadGuard(ConcurrentSkipList &list) noexcept;
+                ~ReadGuard();
+
+                // Never called
+                ReadGuard(ReadGuard const &r)            = delete;
+                ReadGuard &operator=(ReadGuard const &r) = delete;
+
+            private:
+                Readers *readers;
+        };
+
+        static Node *node(Link link) noexcept;
+        static bool  marked(Link link) noexcept;
+        static Link  link(Node *node) noexcept;
+        static int   levelsOf(id_type id) noexcept;
+
+        static bool less(Node const *a, Timestamp due, id_type id) noexcept;
+
+        void find(Timestamp due, id_type id, Node **preds, Node **succs);
+        bool remove(Node *victim);
+        void release(Node *victim);
+        void retire(Node *victim);
+
+        Node head;
+
+        std::unique_ptr<Shard[]> shards;
+
+        // Reclamation, `limbo` holds the nodes retired by the consumer
+        // in each epoch parity, `retiredStack` the ones retired by the
+        // other threads until the consumer moves them into `limbo`
+        std::atomic<std::uint64_t> epoch;
+        Readers                    readers[2];
+        Node                      *limbo[2];
+        std::atomic<Node *>        retiredStack;
+};
+
+/* Template implementation of class methods */
+template<typename T>
+ConcurrentSkipList<T>::ConcurrentSkipList()
+    : head(),
+    shards(new Shard[TIMER_CONCURRENT_SHARDS]),
+    epoch(1U),
+    limbo{nullptr, nullptr},
+    retiredStack(nullptr)
+{
+    head.due    = Timestamp::min();
+    head.id     = 0U;
+    head.levels = TIMER_SKIPLIST_LEVELS;
+
+    for (int l = 0; l < TIMER_SKIPLIST_LEVELS; ++l) {
+        head.links[l].store(link(nullptr), std::memory_order_relaxed);
+    }
+
+    readers[0].count.store(0U, std::memory_order_relaxed);
+    readers[1].count.store(0U, std::memory_order_relaxed);
+}
+
+template<typename T>
+ConcurrentSkipList<T>::~ConcurrentSkipList()
+{
+    // Nodes in the list, marked or not
+    Node *current = node(head.links[0].load());
+
+    while (nullptr != current) {
+        Node *following = node(current->links[0].load());
+        delete current;
+        current = following;
+    }
+
+    // Nodes already unlinked
+    reclaim();
+
+    for (Node *retired : {limbo[0], limbo[1], retiredStack.load()}) {
+        while (nullptr != retired) {
+            Node *following = retired->retired;
+            delete retired;
+            retired = following;
+        }
+    }
+}
+
+template<typename T>
+void ConcurrentSkipList<T>::insert(T &&entry)
+{
+    Node *created = new Node;
+
+    created->due     = entry.next;
+    created->id      = entry.id;
+    created->levels  = levelsOf(entry.id);
+    created->entry   = std::move(entry);
+    created->retired = nullptr;
+    created->linked.store(false, std::memory_order_relaxed);
+    created->holds.store(2, std::memory_order_relaxed);
+
+    {
+        Shard     &shard = shards[created->id % TIMER_CONCURRENT_SHARDS];
+        ScopedLock lock(shard.sync);
+        shard.nodes.emplace(created->id, created);
+    }
+
+    ReadGuard guard(*this);
+    Node     *preds[TIMER_SKIPLIST_LEVELS];
+    Node     *succs[TIMER_SKIPLIST_LEVELS];
+
+    // Link the bottom level, which inserts the entry
+    while (true) {
+        find(created->due, created->id, preds, succs);
+
+        for (int l = 0; l < created->levels; ++l) {
+            created->links[l].store(link(succs[l]));
+        }
+
+        Link expected = link(succs[0]);
+
+        if (preds[0]->links[0].compare_exchange_strong(expected, link(created))) {
+            break;
+        }
+    }
+
+    created->linked.store(true);
+
+    // Then the upper levels, unless it is removed meanwhile. Each
+    // level points to the successor of the last search first: a
+    // retry searches all the levels again, and linking a level
+    // with an older successor would cut out the nodes in between
+    for (int l = 1; l < created->levels; ++l) {
+        while (true) {
+            Link current = created->links[l].load();
+
+            if (marked(current)
+                || ((node(current) != succs[l]) && !created->links[l].compare_exchange_strong(current, link(succs[l]))))
+            {
+                l = created->levels;
+                break;
+            }
+
+            Link expected = link(succs[l]);
+
+            if (preds[l]->links[l].compare_exchange_strong(expected, link(created))) {
+                break;
+            }
+
+            find(created->due, created->id, preds, succs);
+        }
+    }
+
+    // If it was removed while we linked it, make sure no level is left
+    if (marked(created->links[0].load())) {
+        find(created->due, created->id, preds, succs);
+    }
+
+    release(created);
+}
+
+template<typename T>
+bool ConcurrentSkipList<T>::take(id_type id, T &entry)
+{
+    ReadGuard guard(*this);
+    Node     *victim = nullptr;
+
+    {
+        Shard     &shard = shards[id % TIMER_CONCURRENT_SHARDS];
+        ScopedLock lock(shard.sync);
+        auto       i = shard.nodes.find(id);
+
+        // A node being inserted is not known to the caller yet
+        if ((i == shard.nodes.end()) || !i->second->linked.load()) {
+            return false;
+        }
+
+        victim = i->second;
+        shard.nodes.erase(i);
+    }
+
+    // The consumer may have popped it meanwhile
+    if (!remove(victim)) {
+        return false;
+    }
+
+    entry = std::move(victim->entry);
+    release(victim);
+
+    return true;
+}
+
+template<typename T>
+template<typename F>
+void ConcurrentSkipList<T>::pop(Timestamp now, F fn)
+{
+    while (true) {
+        Node *first = nullptr;
+
+        {
+            ReadGuard guard(*this);
+
+            first = node(head.links[0].load());
+
+            // Skip the nodes being removed
+            while ((nullptr != first) && marked(first->links[0].load())) {
+                first = node(first->links[0].load());
+            }
+
+            if ((nullptr == first) || (first->due > now)) {
+                return;
+            }
+
+            if (!remove(first)) {
+                continue;
+            }
+        }
+
+        {
+            Shard     &shard = shards[first->id % TIMER_CONCURRENT_SHARDS];
+            ScopedLock lock(shard.sync);
+            shard.nodes.erase(first->id);
+        }
+
+        fn(std::move(first->entry));
+        release(first);
+    }
+}
+
+template<typename T>
+void ConcurrentSkipList<T>::reclaim()
+{
+    std::uint64_t const current  = epoch.load();
+    std::size_t const   parity   = static_cast<std::size_t>(current & 1U);
+    std::size_t const   previous = parity ^ 1U;
+
+    // Nodes retired by the other threads belong to this epoch
+    Node *retired = retiredStack.exchange(nullptr);
+
+    while (nullptr != retired) {
+        Node *following = retired->retired;
+
+        retired->retired = limbo[parity];
+        limbo[parity]    = retired;
+        retired          = following;
+    }
+
+    if (0U != readers[previous].count.load()) {
+        return;
+    }
+
+    // The readers of the previous epoch left
+    while (nullptr != limbo[previous]) {
+        Node *following = limbo[previous]->retired;
+        delete limbo[previous];
+        limbo[previous] = following;
+    }
+
+    if (nullptr != limbo[parity]) {
+        epoch.store(current + 1U);
+    }
+}
+
+template<typename T>
+typename ConcurrentSkipList<T>::Timestamp ConcurrentSkipList<T>::next()
+{
+    ReadGuard guard(*this);
+    Node     *first = node(head.links[0].load());
+
+    while ((nullptr != first) && marked(first->links[0].load())) {
+        first = node(first->links[0].load());
+    }
+
+    return (nullptr == first) ? Timestamp::max() : first->due;
+}
+
+template<typename T>
+void ConcurrentSkipList<T>::clear()
+{
+    std::vector<id_type> ids;
+
+    for (std::size_t i = 0U; i < TIMER_CONCURRENT_SHARDS; ++i) {
+        ScopedLock lock(shards[i].sync);
+
+        for (auto const &entry : shards[i].nodes) {
+            ids.push_back(entry.first);
+        }
+    }
+
+    T entry;
+
+    for (id_type const &id : ids) {
+        take(id, entry);
+    }
+}
+
+template<typename T>
+std::size_t ConcurrentSkipList<T>::size() const
+{
+    std::size_t lSize = 0U;
+
+    for (std::size_t i = 0U; i < TIMER_CONCURRENT_SHARDS; ++i) {
+        ScopedLock lock(shards[i].sync);
+        lSize += shards[i].nodes.size();
+    }
+
+    return lSize;
+}
+
+template<typename T>
+ConcurrentSkipList<T>::ReadGuard::ReadGuard(ConcurrentSkipList &list) noexcept
+    : readers(nullptr)
+{
+    while (true) {
+        std::uint64_t const current = list.epoch.load();
+
+        readers = &(list.readers[current & 1U]);
+        readers->count.fetch_add(1U);
+
+        // Registered before the consumer moved to the next epoch
+        if (list.epoch.load() == current) {
+            return;
+        }
+
+        readers->count.fetch_sub(1U);
+    }
+}
+
+template<typename T>
+ConcurrentSkipList<T>::ReadGuard::~ReadGuard()
+{
+    readers->count.fetch_sub(1U);
+}
+
+template<typename T>
+typename ConcurrentSkipList<T>::Node *ConcurrentSkipList<T>::node(Link link) noexcept
+{
+    return reinterpret_cast<Node *>(link & ~static_cast<Link>(1U));
+}
+
+template<typename T>
+bool ConcurrentSkipList<T>::marked(Link link) noexcept
+{
+    return 0U != (link & 1U);
+}
+
+template<typename T>
+typename ConcurrentSkipList<T>::Link ConcurrentSkipList<T>::link(Node *node) noexcept
+{
+    return reinterpret_cast<Link>(node);
+}
+
+template<typename T>
+int ConcurrentSkipList<T>::levelsOf(id_type id) noexcept
+{
+    // Hash the ID, each level holds half of the nodes of the one below
+    std::uint64_t hash = static_cast<std::uint64_t>(id);
+
+    hash ^= hash >> 33U;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33U;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33U;
+
+    int levels = 1;
+
+    while ((levels < TIMER_SKIPLIST_LEVELS) && (0U != (hash & 1U))) {
+        ++levels;
+        hash >>= 1U;
+    }
+
+    return levels;
+}
+
+template<typename T>
+bool ConcurrentSkipList<T>::less(Node const *a, Timestamp due, id_type id) noexcept
+{
+    return (a->due < due) || ((a->due == due) && (a->id < id));
+}
+
+// NOTE: called within a ReadGuard. Fills the predecessors and
+// successors of (due, id) at each level, unlinking the marked
+// nodes on the way
+template<typename T>
+void ConcurrentSkipList<T>::find(Timestamp due, id_type id, Node **preds, Node **succs)
+{
+retry:
+    Node *pred = &head;
+
+    for (int l = TIMER_SKIPLIST_LEVELS - 1; l >= 0; --l) {
+        Link const first = pred->links[l].load();
+
+        // The predecessor was removed since the level above: its
+        // link may skip nodes inserted after it was unlinked, and
+        // a removal must not leave any of them behind
+        if (marked(first)) {
+            goto retry;
+        }
+
+        Node *current = node(first);
+
+        while (nullptr != current) {
+            Link following = current->links[l].load();
+
+            // Unlink the nodes removed at this level
+            while (marked(following)) {
+                Link expected = link(current);
+
+                if (!pred->links[l].compare_exchange_strong(expected, link(node(following)))) {
+                    goto retry;
+                }
+
+                current = node(following);
+
+                if (nullptr == current) {
+                    break;
+                }
+
+                following = current->links[l].load();
+            }
+
+            if ((nullptr == current) || !less(current, due, id)) {
+                break;
+            }
+
+            pred    = current;
+            current = node(following);
+        }
+
+        preds[l] = pred;
+        succs[l] = current;
+    }
+}
+
+// NOTE: called within a ReadGuard. Returns true if
+// the calling thread removed the node, and owns it
+template<typename T>
+bool ConcurrentSkipList<T>::remove(Node *victim)
+{
+    for (int l = victim->levels - 1; l > 0; --l) {
+        Link current = victim->links[l].load();
+
+        while (!marked(current) && !victim->links[l].compare_exchange_weak(current, current | 1U)) {
+            /* Retry with the updated link */
+        }
+    }
+
+    Link current = victim->links[0].load();
+
+    while (!marked(current)) {
+        if (victim->links[0].compare_exchange_weak(current, current | 1U)) {
+            Node *preds[TIMER_SKIPLIST_LEVELS];
+            Node *succs[TIMER_SKIPLIST_LEVELS];
+
+            // Unlink it from every level
+            find(victim->due, victim->id, preds, succs);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// NOTE: a removed node stays reachable until its inserter is done
+// linking it, whoever of the two lets go last retires it
+template<typename T>
+void ConcurrentSkipList<T>::release(Node *victim)
+{
+    if (1 == victim->holds.fetch_sub(1)) {
+        retire(victim);
+    }
+}
+
+template<typename T>
+void ConcurrentSkipList<T>::retire(Node *victim)
+{
+    Node *top = retiredStack.load();
+
+    do {
+        victim->retired = top;
+    } while (!retiredStack.compare_exchange_weak(top, victim));
+}
+
+#endif /* CONCURRENTSKIPLIST_HXX */
@@ -0,0 +1,337 @@
+/**
+ * ConcurrentWheel class definition
+ *
+ * @file ConcurrentWheel.hxx
+ */
+
+#ifndef CONCURRENTWHEEL_HXX
+#define CONCURRENTWHEEL_HXX
+
+/* Includes -------------------------------------------- */
+#include "TimerLock.hxx"
+
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstddef>
+
+/* Defines --------------------------------------------- */
+#ifndef TIMER_CONCURRENT_SHARDS
+#define TIMER_CONCURRENT_SHARDS 64 /* Independently locked shards of the ID index */
+#endif /* TIMER_CONCURRENT_SHARDS */
+
+/* ConcurrentWheel class definition -------------------- */
+/** @brief Timing wheel shared by many producers and one consumer
+ *
+ * The entries are kept in an index sharded by ID, and referenced
+ * by the bucket of their tick. Each shard and each bucket has its
+ * own TimerSpinLock, so concurrent insertions and cancellations
+ * only contend when they hit the same shard or the same tick.
+ *
+ * The consumer collects the references of the entries coming due,
+ * then claims them from the index. An entry taken out of the index
+ * before it is claimed is cancelled, and its reference is dropped
+ * when the consumer collects it.
+ *
+ * Entries are collected one tick ahead, so an entry due within the
+ * next tick is refused by insert(), and must be handled otherwise.
+ *
+ * T must be movable and have an `id` (unique) and a `next`
+ * (std::chrono::time_point) member.
+ */
+template<typename T>
+class ConcurrentWheel
+{
+    public:
+        using id_type   = decltype(T::id);
+        using Timestamp = decltype(T::next);
+        using Duration  = std::chrono::microseconds;
+
+        /** @brief Constructor allocates `slots` buckets of `resolution` */
+        explicit ConcurrentWheel(std::size_t slots, Duration resolution);
+
+        // Never called
+        ConcurrentWheel(ConcurrentWheel const &r)            = delete;
+        ConcurrentWheel &operator=(ConcurrentWheel const &r) = delete;
+
+        /** @brief Insert an entry, from any thread
+         *
+         * @return false if it is due too soon, it is left untouched
+         */
+        bool insert(T &entry);
+
+        /** @brief Take an entry out before it is claimed, from any thread
+         *
+         * @return false if there is no such entry
+         */
+        bool take(id_type id, T &entry);
+
+        /** @brief Time at which the consumer collects an entry due at `next` */
+        Timestamp collectedAt(Timestamp next) const noexcept;
+
+        /** @brief Whether collect() has ticks to go through at `now` */
+        bool due(Timestamp now) const noexcept;
+
+        /** @brief Collect the entries coming due at `now`, consumer only
+         * Only takes the locks of the buckets it goes through
+         */
+        void collect(Timestamp now);
+
+        /** @brief Claim the collected entries, consumer only
+         * `fn` is called with each entry that was not taken
+         */
+        template<typename F>
+        void claim(F fn);
+
+        /** @brief When the next entry is collected, consumer only
+         * Timestamp::max() if the wheel is empty
+         */
+        Timestamp next() const noexcept;
+
+        /** @brief Drop all the entries */
+        void clear();
+
+        /* Peek at current state */
+        std::size_t size() const;
+
+    private:
+        using ScopedLock = std::unique_lock<TimerSpinLock>;
+
+        // Entry of a bucket
+        struct Ref {
+            id_type      id;
+            std::int64_t tick;
+        };
+
+        struct alignas(64) Bucket {
+            TimerSpinLock            sync;
+            std::int64_t             tick; /* Last tick collected from this bucket */
+            std::vector<Ref>         refs;
+            std::atomic<std::size_t> count;
+        };
+
+        struct alignas(64) Shard {
+            TimerSpinLock                  sync;
+            std::unordered_map<id_type, T> entries;
+        };
+
+        std::int64_t tick(Timestamp time) const noexcept;
+        Timestamp    start(std::int64_t tick) const noexcept;
+
+        std::size_t const slots;
+        Duration const    resolution;
+
+        std::unique_ptr<Bucket[]> buckets;
+        std::unique_ptr<Shard[]>  shards;
+
+        // Last tick collected, and IDs collected but not claimed yet
+        std::atomic<std::int64_t> cursor;
+        std::vector<id_type>      collected;
+};
+
+/* Template implementation of class methods */
+template<typename T>
+ConcurrentWheel<T>::ConcurrentWheel(std::size_t slots, Duration resolution)
+    : slots(slots),
+    resolution(resolution),
+    buckets(new Bucket[slots]),
+    shards(new Shard[TIMER_CONCURRENT_SHARDS]),
+    cursor(0),
+    collected()
+{
+    std::int64_t const now = tick(Timestamp::clock::now());
+
+    cursor.store(now, std::memory_order_relaxed);
+
+    for (std::size_t i = 0U; i < slots; ++i) {
+        buckets[i].tick = now;
+        buckets[i].count.store(0U, std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+bool ConcurrentWheel<T>::insert(T &entry)
+{
+    std::int64_t const lTick = tick(entry.next);
+
+    // Cheap check first, the bucket's tick is checked below
+    if (lTick <= cursor.load(std::memory_order_acquire) + 1) {
+        return false;
+    }
+
+    id_type const id     = entry.id;
+    Shard        &shard  = shards[id % TIMER_CONCURRENT_SHARDS];
+    Bucket       &bucket = buckets[static_cast<std::size_t>(lTick) % slots];
+    bool          late   = false;
+
+    {
+        ScopedLock lock(shard.sync);
+        shard.entries.emplace(id, std::move(entry));
+    }
+
+    {
+        ScopedLock lock(bucket.sync);
+
+        if (lTick <= bucket.tick) {
+            // The consumer went past this tick meanwhile
+            late = true;
+        } else {
+            bucket.refs.push_back(Ref{id, lTick});
+
+            // Sequentially consistent, so that either the consumer
+            // sees this entry before it sleeps, or the producer sees
+            // when the consumer sleeps until
+            bucket.count.fetch_add(1U, std::memory_order_seq_cst);
+        }
+    }
+
+    if (late) {
+        ScopedLock lock(shard.sync);
+        auto       i = shard.entries.find(id);
+
+        entry = std::move(i->second);
+        shard.entries.erase(i);
+
+        return false;
+    }
+
+    return true;
+}
+
+template<typename T>
+bool ConcurrentWheel<T>::take(id_type id, T &entry)
+{
+    Shard     &shard = shards[id % TIMER_CONCURRENT_SHARDS];
+    ScopedLock lock(shard.sync);
+    auto       i = shard.entries.find(id);
+
+    if (i == shard.entries.end()) {
+        return false;
+    }
+
+    entry = std::move(i->second);
+    shard.entries.erase(i);
+
+    return true;
+}
+
+template<typename T>
+typename ConcurrentWheel<T>::Timestamp ConcurrentWheel<T>::collectedAt(Timestamp next) const noexcept
+{
+    return start(tick(next) - 1);
+}
+
+template<typename T>
+bool ConcurrentWheel<T>::due(Timestamp now) const noexcept
+{
+    return tick(now) + 1 > cursor.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+void ConcurrentWheel<T>::collect(Timestamp now)
+{
+    std::int64_t const target = tick(now) + 1;
+    std::int64_t const last   = cursor.load(std::memory_order_relaxed);
+
+    // Each bucket is gone through once at most
+    for (std::int64_t t = std::max(last + 1, target - static_cast<std::int64_t>(slots) + 1); t <= target; ++t) {
+        Bucket    &bucket = buckets[static_cast<std::size_t>(t) % slots];
+        ScopedLock lock(bucket.sync);
+
+        bucket.tick = t;
+
+        if (0U == bucket.count.load(std::memory_order_relaxed)) {
+            continue;
+        }
+
+        // Keep the references of the next rounds in place
+        auto keep = std::remove_if(bucket.refs.begin(), bucket.refs.end(),
+                                    [this, target](Ref const &ref) {
+                                        if (ref.tick > target) {
+                                            return false;
+                                        }
+
+                                        collected.push_back(ref.id);
+                                        return true;
+                                    });
+
+        bucket.refs.erase(keep, bucket.refs.end());
+        bucket.count.store(bucket.refs.size(), std::memory_order_relaxed);
+    }
+
+    cursor.store(target, std::memory_order_release);
+}
+
+template<typename T>
+template<typename F>
+void ConcurrentWheel<T>::claim(F fn)
+{
+    for (id_type const &id : collected) {
+        T entry;
+
+        if (take(id, entry)) {
+            fn(std::move(entry));
+        }
+    }
+
+    collected.clear();
+}
+
+template<typename T>
+typename ConcurrentWheel<T>::Timestamp ConcurrentWheel<T>::next() const noexcept
+{
+    std::int64_t const last = cursor.load(std::memory_order_relaxed);
+
+    for (std::size_t i = 1U; i <= slots; ++i) {
+        std::int64_t const t = last + static_cast<std::int64_t>(i);
+
+        if (0U < buckets[static_cast<std::size_t>(t) % slots].count.load(std::memory_order_seq_cst)) {
+            return start(t - 1);
+        }
+    }
+
+    return Timestamp::max();
+}
+
+template<typename T>
+void ConcurrentWheel<T>::clear()
+{
+    // The references are dropped when they are collected
+    for (std::size_t i = 0U; i < TIMER_CONCURRENT_SHARDS; ++i) {
+        ScopedLock lock(shards[i].sync);
+        shards[i].entries.clear();
+    }
+}
+
+template<typename T>
+std::size_t ConcurrentWheel<T>::size() const
+{
+    std::size_t lSize = 0U;
+
+    for (std::size_t i = 0U; i < TIMER_CONCURRENT_SHARDS; ++i) {
+        ScopedLock lock(shards[i].sync);
+        lSize += shards[i].entries.size();
+    }
+
+    return lSize;
+}
+
+template<typename T>
+std::int64_t ConcurrentWheel<T>::tick(Timestamp time) const noexcept
+{
+    return std::chrono::duration_cast<Duration>(time.time_since_epoch()).count() / resolution.count();
+}
+
+template<typename T>
+typename ConcurrentWheel<T>::Timestamp ConcurrentWheel<T>::start(std::int64_t tick) const noexcept
+{
+    return Timestamp(std::chrono::duration_cast<typename Timestamp::duration>(resolution * tick));
+}
+
+#endif /* CONCURRENTWHEEL_HXX */
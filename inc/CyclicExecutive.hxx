@@ -0,0 +1,147 @@
+/**
+ * CyclicExecutive class definition
+ *
+ * @file CyclicExecutive.hxx
+ */
+
+#ifndef CYCLICEXECUTIVE_HXX
+#define CYCLICEXECUTIVE_HXX
+
+/* Includes -------------------------------------------- */
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include <cstdint>
+#include <cstddef>
+
+/* CyclicExecutive class definition -------------------- */
+/** @brief Static cyclic executive for fixed periodic task sets
+ *
+ * Where TimerThread keeps a dynamic ordering queue, the cyclic
+ * executive is meant for control loops whose periodic handlers
+ * are all known at startup and have harmonic periods.
+ *
+ * When started, it precomputes a schedule table made of
+ * minor frames (the GCD of the periods) repeated over a
+ * major frame (the LCM of the periods). The worker then walks
+ * the table using absolute sleeps on CLOCK_MONOTONIC, so no
+ * queue operation is done when a handler fires, handlers of
+ * a frame always run in the same order (shortest period first,
+ * then registration order), and an overrun is detected when
+ * a frame completes after the start of the next one.
+ */
+class CyclicExecutive
+{
+    public:
+        /* Defining the task ID type */
+        using task_id_t = std::size_t; /* Index of the task in registration order */
+        static task_id_t constexpr no_task = static_cast<task_id_t>(-1);
+
+        /* Defining the handler function types */
+        using handler_type         = std::function<void()>;
+        using overrun_handler_type = std::function<void(std::size_t, std::int64_t)>; /* Frame index, overrun in microseconds */
+
+        /* Defining the microsecond type */
+        using time_us_t = std::int64_t; /* Values that are a large-range microsecond count */
+
+        /** @brief Constructor does not start the worker, see start() */
+        explicit CyclicExecutive();
+
+        /** @brief Destructor stops the worker. The handlers of the
+         * current frame are guaranteed to have returned before
+         * this destructor returns
+         */
+        ~CyclicExecutive();
+
+        /** @brief Register a periodic handler
+         * The handler will be called every `period` microseconds,
+         * in the first frame and then every `period / minorFrame()`
+         * minor frames.
+         * Tasks can only be registered while the executive is stopped
+         *
+         * @return The task's ID, or no_task on error
+         */
+        task_id_t addTask(handler_type handler, time_us_t period);
+
+        /** @brief Set the handler called when a frame overruns
+         * The handler is called from the worker, after the frame
+         * that overran. It can only be set while the executive is stopped
+         */
+        int setOverrunHandler(overrun_handler_type handler);
+
+        /** @brief Build the schedule table and start the worker
+         * Fails if no task is registered, if the periods are not
+         * harmonic or if the executive is already running
+         *
+         * @return 0 on success, 255 on error
+         */
+        int start();
+
+        /** @brief Stop the worker after the current frame
+         * The registered tasks and the schedule table are kept,
+         * so the executive can be started again.
+         * It can't be called from a handler
+         *
+         * @return 0 on success, 255 on error
+         */
+        int stop();
+
+        /** @brief Set the worker's priority
+         */
+        int setScheduling(const int &pPolicy, const int &pPriority);
+
+        /** @brief Get the worker's priority
+         */
+        int scheduling(int * const pPolicy, int * const pPriority) noexcept;
+
+        /* Peek at current state */
+        bool        running() const noexcept;
+        time_us_t   minorFrame() const noexcept;
+        time_us_t   majorFrame() const noexcept;
+        std::size_t frameCount() const noexcept;
+        std::size_t taskCount() const noexcept;
+
+        /** @brief Number of frames that completed after the start of
+         * the next frame since the executive was started
+         */
+        std::uint64_t overruns() const noexcept;
+
+    private:
+        /* Type definitions */
+        using Lock       = std::mutex;
+        using ScopedLock = std::unique_lock<Lock>;
+
+        /** @brief Task structure definition */
+        struct Task {
+            handler_type handler;
+            time_us_t    period;
+        };
+
+        void cyclicExecutiveWorker();
+        int  buildTable();
+
+        // Registered tasks, in registration order
+        std::vector<Task> tasks;
+
+        // Schedule table, stored as a compressed row array:
+        // the tasks of frame `f` are table[frames[f]] to table[frames[f + 1] - 1]
+        std::vector<std::size_t> frames;
+        std::vector<std::size_t> table;
+
+        time_us_t minor;
+        time_us_t major;
+
+        overrun_handler_type overrunHandler;
+
+        // Protects the configuration against concurrent start/stop calls
+        mutable Lock       sync;
+        std::thread        worker;
+        bool               stopping; /* Whether stop() is joining the worker */
+        std::atomic<bool>  done;
+        std::atomic<std::uint64_t> overrunCount;
+};
+
+#endif /* CYCLICEXECUTIVE_HXX */
@@ -0,0 +1,461 @@
+/**
+ * ExpiringMap class definition
+ *
+ * @file ExpiringMap.hxx
+ */
+
+#ifndef EXPIRINGMAP_HXX
+#define EXPIRINGMAP_HXX
+
+/* Includes -------------------------------------------- */
+#include "TimerThread.hxx"
+
+#include <functional>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <mutex>
+
+#include <cstdint>
+#include <cstddef>
+
+/* ExpiringMap class definition ------------------------ */
+/** @brief Associative container with built-in expiry
+ *
+ * Each entry carries its own deadline and the links of an
+ * intrusive hashed timing wheel, so the map needs a single
+ * periodic timer on its TimerThread whatever the number of
+ * entries. Expired entries are removed in batches by this
+ * timer, every `resolution` microseconds.
+ *
+ * Lookups check the entry's deadline, so an entry that expired
+ * but was not swept yet is treated as absent.
+ *
+ * Touching an entry only moves its deadline. A later deadline
+ * is relinked lazily, when the sweep reaches its former bucket,
+ * which makes touch() O(1). An earlier one is relinked at once.
+ */
+template<typename Key,
+            typename Value,
+            typename Hash     = std::hash<Key>,
+            typename KeyEqual = std::equal_to<Key>>
+class ExpiringMap
+{
+    public:
+        /* Defining the microsecond type */
+        using time_us_t = TimerThread::time_us_t;
+
+        /* Defining the expiry handler type
+         * Called from the TimerThread's worker for each expired entry
+         */
+        using expiry_handler_type = std::function<void(Key const &, Value &)>;
+
+        /** @brief Constructor starts the sweeping timer on `timerThread`
+         * Entries inserted without an explicit TTL expire `ttl`
+         * microseconds after their last insertion or touch.
+         * Expiry is batched every `resolution` microseconds.
+         */
+        explicit ExpiringMap(time_us_t    ttl,
+                                time_us_t    resolution,
+                                TimerThread &timerThread = TimerThread::global());
+
+        /** @brief Destructor stops the sweeping timer. No expiry
+         * handler is running once this destructor returns
+         */
+        ~ExpiringMap();
+
+        // Never called
+        ExpiringMap(ExpiringMap const &r)            = delete;
+        ExpiringMap &operator=(ExpiringMap const &r) = delete;
+
+        /** @brief Set the handler called for each expired entry
+         * It is not called for erased entries
+         */
+        void setExpiryHandler(expiry_handler_type handler);
+
+        /** @brief Insert or assign an entry
+         * The entry expires `ttl` microseconds from now
+         *
+         * @return true if the entry was inserted, false if assigned
+         */
+        bool insert(Key const &key, Value value);
+        bool insert(Key const &key, Value value, time_us_t ttl);
+
+        /** @brief Get a copy of the value of an entry
+         * Expired entries are treated as absent
+         */
+        std::optional<Value> find(Key const &key) const;
+        bool                 contains(Key const &key) const;
+
+        /** @brief Extend the TTL of an entry, in O(1)
+         * The entry expires `ttl` microseconds from now
+         *
+         * @return false if the entry is absent or expired
+         */
+        bool touch(Key const &key);
+        bool touch(Key const &key, time_us_t ttl);
+
+        /** @brief Remove an entry
+         *
+         * @return false if the entry is absent or expired
+         */
+        bool erase(Key const &key);
+
+        /** @brief Remove all entries */
+        void clear();
+
+        /** @brief Remove the expired entries right away,
+         * without waiting for the next sweep
+         */
+        void expire();
+
+        /* Peek at current state
+         * size() counts the expired entries that are not swept yet
+         */
+        std::size_t size() const noexcept;
+        bool        empty() const noexcept;
+
+    private:
+        /* Type definitions */
+        using Lock       = std::mutex;
+        using ScopedLock = std::unique_lock<Lock>;
+
+        using Clock     = std::chrono::steady_clock;
+        using Timestamp = std::chrono::time_point<Clock>;
+        using Duration  = std::chrono::microseconds;
+
+        /** @brief Entry structure definition */
+        struct Entry {
+            Value     value;
+            Timestamp deadline;
+
+            // Intrusive links of the wheel bucket holding the entry
+            Entry      *prev;
+            Entry      *next;
+            std::size_t slot;
+
+            // Key of the entry in `entries`, which never moves
+            Key const *key;
+        };
+
+        using EntryMap = std::unordered_map<Key, Entry, Hash, KeyEqual>;
+        using NodeList = std::vector<typename EntryMap::node_type>;
+
+        std::int64_t tick(Timestamp t) const noexcept;
+        std::size_t  bucket(Timestamp t) const noexcept;
+        void         link(Entry &entry) noexcept;
+        void         unlink(Entry &entry) noexcept;
+        void         move(Entry &entry, Timestamp deadline) noexcept;
+        void         sweep(ScopedLock &lock);
+
+        Duration ttl;
+        Duration resolution;
+
+        // The entries are physically stored in this map
+        EntryMap entries;
+
+        // Hashed timing wheel, one bucket per `resolution` tick
+        std::vector<Entry *> wheel;
+        std::int64_t         swept;
+
+        expiry_handler_type expiryHandler;
+
+        mutable Lock            sync;
+        TimerThread            &timerThread;
+        TimerThread::timer_id_t sweeper;
+};
+
+/* Template implementation of class methods */
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+ExpiringMap<Key, Value, Hash, KeyEqual>::ExpiringMap(time_us_t    ttl,
+                                                        time_us_t    resolution,
+                                                        TimerThread &timerThread)
+    : ttl(ttl),
+    resolution(resolution > 0 ? resolution : 1),
+    entries(),
+    swept(0),
+    timerThread(timerThread),
+    sweeper(TimerThread::no_timer)
+{
+    // Enough buckets for the default TTL to fit in one revolution.
+    // Longer TTLs stay in their bucket for several revolutions
+    std::int64_t buckets = (ttl / this->resolution.count()) + 1;
+
+    if (buckets > (1 << 16)) {
+        buckets = (1 << 16);
+    }
+
+    wheel.assign(static_cast<std::size_t>(buckets), nullptr);
+    swept = tick(Clock::now());
+
+    sweeper = timerThread.setInterval([this]() {
+                                            ScopedLock lock(sync);
+                                            sweep(lock);
+                                        },
+                                        this->resolution.count());
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+ExpiringMap<Key, Value, Hash, KeyEqual>::~ExpiringMap()
+{
+    // Synchronizes with a sweep in progress
+    timerThread.clearTimer(sweeper);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+void ExpiringMap<Key, Value, Hash, KeyEqual>::setExpiryHandler(expiry_handler_type handler)
+{
+    ScopedLock lock(sync);
+
+    expiryHandler = std::move(handler);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+bool ExpiringMap<Key, Value, Hash, KeyEqual>::insert(Key const &key, Value value)
+{
+    return insert(key, std::move(value), ttl.count());
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+bool ExpiringMap<Key, Value, Hash, KeyEqual>::insert(Key const &key, Value value, time_us_t ttl)
+{
+    ScopedLock lock(sync);
+    Timestamp  deadline = Clock::now() + Duration(ttl);
+    auto       i        = entries.find(key);
+
+    if (i != entries.end()) {
+        i->second.value = std::move(value);
+        move(i->second, deadline);
+
+        return false;
+    }
+
+    i = entries.emplace(key, Entry{std::move(value), deadline, nullptr, nullptr, 0U, nullptr}).first;
+    i->second.key = &(i->first);
+    link(i->second);
+
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+std::optional<Value> ExpiringMap<Key, Value, Hash, KeyEqual>::find(Key const &key) const
+{
+    ScopedLock lock(sync);
+    auto       i = entries.find(key);
+
+    if ((i == entries.end()) || (i->second.deadline <= Clock::now())) {
+        return std::nullopt;
+    }
+
+    return i->second.value;
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+bool ExpiringMap<Key, Value, Hash, KeyEqual>::contains(Key const &key) const
+{
+    ScopedLock lock(sync);
+    auto       i = entries.find(key);
+
+    return (i != entries.end()) && (i->second.deadline > Clock::now());
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+bool ExpiringMap<Key, Value, Hash, KeyEqual>::touch(Key const &key)
+{
+    return touch(key, ttl.count());
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+bool ExpiringMap<Key, Value, Hash, KeyEqual>::touch(Key const &key, time_us_t ttl)
+{
+    ScopedLock lock(sync);
+    Timestamp  now = Clock::now();
+    auto       i   = entries.find(key);
+
+    if ((i == entries.end()) || (i->second.deadline <= now)) {
+        return false;
+    }
+
+    move(i->second, now + Duration(ttl));
+
+    return true;
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+bool ExpiringMap<Key, Value, Hash, KeyEqual>::erase(Key const &key)
+{
+    ScopedLock lock(sync);
+    auto       i = entries.find(key);
+
+    if (i == entries.end()) {
+        return false;
+    }
+
+    bool const alive = (i->second.deadline > Clock::now());
+
+    unlink(i->second);
+    entries.erase(i);
+
+    return alive;
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+void ExpiringMap<Key, Value, Hash, KeyEqual>::clear()
+{
+    ScopedLock lock(sync);
+
+    entries.clear();
+    wheel.assign(wheel.size(), nullptr);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+void ExpiringMap<Key, Value, Hash, KeyEqual>::expire()
+{
+    ScopedLock lock(sync);
+
+    sweep(lock);
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+std::size_t ExpiringMap<Key, Value, Hash, KeyEqual>::size() const noexcept
+{
+    ScopedLock lock(sync);
+
+    return entries.size();
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+bool ExpiringMap<Key, Value, Hash, KeyEqual>::empty() const noexcept
+{
+    ScopedLock lock(sync);
+
+    return entries.empty();
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+std::int64_t ExpiringMap<Key, Value, Hash, KeyEqual>::tick(Timestamp t) const noexcept
+{
+    return std::chrono::duration_cast<Duration>(t.time_since_epoch()).count() / resolution.count();
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+std::size_t ExpiringMap<Key, Value, Hash, KeyEqual>::bucket(Timestamp t) const noexcept
+{
+    // Deadlines in already swept ticks go to the next tick
+    // to be swept, instead of waiting for a whole revolution
+    std::int64_t const t1 = tick(t);
+    std::int64_t const t2 = (t1 > swept) ? t1 : swept + 1;
+
+    return static_cast<std::size_t>(t2) % wheel.size();
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+void ExpiringMap<Key, Value, Hash, KeyEqual>::link(Entry &entry) noexcept
+{
+    entry.slot   = bucket(entry.deadline);
+    Entry *&head = wheel[entry.slot];
+
+    entry.prev = nullptr;
+    entry.next = head;
+
+    if (nullptr != head) {
+        head->prev = &entry;
+    }
+
+    head = &entry;
+}
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+void ExpiringMap<Key, Value, Hash, KeyEqual>::unlink(Entry &entry) noexcept
+{
+    if (nullptr != entry.next) {
+        entry.next->prev = entry.prev;
+    }
+
+    if (nullptr != entry.prev) {
+        entry.prev->next = entry.next;
+    } else {
+        wheel[entry.slot] = entry.next;
+    }
+}
+
+// Moves the deadline of a linked entry. A later deadline is left to
+// the sweep, but an earlier one must be relinked, or the entry would
+// only expire when the sweep reaches its former bucket
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+void ExpiringMap<Key, Value, Hash, KeyEqual>::move(Entry &entry, Timestamp deadline) noexcept
+{
+    std::int64_t const size  = static_cast<std::int64_t>(wheel.size());
+    std::int64_t const first = swept + 1;
+
+    // Next tick sweeping the current bucket, and first one for the deadline
+    std::int64_t const visit = first + ((static_cast<std::int64_t>(entry.slot) - (first % size) + size) % size);
+    std::int64_t const due   = std::max(tick(deadline), first);
+
+    entry.deadline = deadline;
+
+    if (due < visit) {
+        unlink(entry);
+        link(entry);
+    }
+}
+
+// NOTE: returns with the lock held, but releases it while
+// the expiry handler is called for the expired entries
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+void ExpiringMap<Key, Value, Hash, KeyEqual>::sweep(ScopedLock &lock)
+{
+    Timestamp const    now     = Clock::now();
+    std::int64_t const nowTick = tick(now);
+    std::int64_t       first   = swept + 1;
+    NodeList           expired;
+
+    // Past a whole revolution, every bucket is swept once
+    if ((nowTick - first) >= static_cast<std::int64_t>(wheel.size())) {
+        first = nowTick - static_cast<std::int64_t>(wheel.size()) + 1;
+    }
+
+    swept = nowTick;
+
+    for (std::int64_t t = first; t <= nowTick; ++t) {
+        std::size_t const b     = static_cast<std::size_t>(t) % wheel.size();
+        Entry            *entry = wheel[b];
+
+        // Detach the whole bucket, then put back what has not expired
+        wheel[b] = nullptr;
+
+        while (nullptr != entry) {
+            Entry *next = entry->next;
+
+            if (entry->deadline <= now) {
+                expired.push_back(entries.extract(*(entry->key)));
+            } else {
+                // Not expired yet: either a later revolution of this
+                // bucket, or an entry that was touched since it was linked
+                link(*entry);
+            }
+
+            entry = next;
+        }
+    }
+
+    if (expired.empty() || !expiryHandler) {
+        return;
+    }
+
+    // Call the handler outside the lock,
+    // it may use the map
+    expiry_handler_type handler = expiryHandler;
+
+    lock.unlock();
+
+    for (auto &node : expired) {
+        handler(node.key(), node.mapped().value);
+    }
+
+    lock.lock();
+}
+
+#endif /* EXPIRINGMAP_HXX */
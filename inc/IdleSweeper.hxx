@@ -0,0 +1,138 @@
+/**
+ * IdleSweeper class definition
+ *
+ * @file IdleSweeper.hxx
+ */
+
+#ifndef IDLESWEEPER_HXX
+#define IDLESWEEPER_HXX
+
+/* Includes -------------------------------------------- */
+#include "TimerThread.hxx"
+
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <atomic>
+
+#include <cstdint>
+#include <cstddef>
+
+/* IdleSweeper class definition ------------------------ */
+/** @brief Idle timeouts for large connection tables
+ *
+ * Instead of one timer per connection, reset on every packet,
+ * each connection gets a slot in a contiguous array of
+ * last-activity timestamps. Marking activity is a single
+ * relaxed store, and one periodic TimerThread task sweeps the
+ * whole array every `granularity` microseconds, calling the
+ * expiry handler for the slots that have been idle for more
+ * than the idle timeout.
+ *
+ * The sweep first counts the idle candidates of each block of
+ * 64 slots, and only tries to expire the slots of the blocks
+ * that have some.
+ *
+ * An idle slot is closed before its expiry handler is called.
+ */
+class IdleSweeper
+{
+    public:
+        /* Defining the slot type */
+        using slot_t = std::size_t;
+        static slot_t constexpr no_slot = static_cast<slot_t>(-1);
+
+        /* Defining the microsecond type */
+        using time_us_t = TimerThread::time_us_t;
+
+        /* Defining the expiry handler type
+         * Called from the TimerThread's worker with the idle slot
+         */
+        using expiry_handler_type = std::function<void(slot_t)>;
+
+        /** @brief Constructor starts the sweeping task on `timerThread`
+         * The table holds up to `capacity` slots, allocated once.
+         * Slots that were not touched for `idleTimeout` microseconds
+         * expire during the next sweep, so they expire between
+         * `idleTimeout` and `idleTimeout + granularity` microseconds
+         * after their last activity
+         */
+        explicit IdleSweeper(std::size_t         capacity,
+                                time_us_t           idleTimeout,
+                                time_us_t           granularity,
+                                expiry_handler_type handler,
+                                TimerThread        &timerThread = TimerThread::global());
+
+        /** @brief Destructor stops the sweeping task. No expiry
+         * handler is running once this destructor returns
+         */
+        ~IdleSweeper();
+
+        // Never called
+        IdleSweeper(IdleSweeper const &r)            = delete;
+        IdleSweeper &operator=(IdleSweeper const &r) = delete;
+
+        /** @brief Open a slot, marked active now
+         * Slots are reused once closed
+         *
+         * @return The slot, or no_slot if the table is full
+         */
+        slot_t open();
+
+        /** @brief Close a slot without calling the expiry handler
+         *
+         * @return false if the slot was not open
+         */
+        bool close(slot_t slot);
+
+        /** @brief Mark activity on an open slot
+         * This does not lock and can be called from any thread.
+         * It has no effect on a closed slot, so touching a slot
+         * while it expires can't reopen it, nor on a slot out of
+         * the capacity, such as no_slot
+         */
+        void touch(slot_t slot) noexcept;
+
+        /** @brief Sweep the table right away */
+        void sweep();
+
+        /* Peek at current state */
+        std::size_t size() const noexcept;
+        std::size_t capacity() const noexcept;
+
+    private:
+        /* Type definitions */
+        using Lock       = std::mutex;
+        using ScopedLock = std::unique_lock<Lock>;
+
+        // Timestamp of the closed slots, which never expire
+        static std::int64_t constexpr closed = INT64_MAX;
+
+        static std::int64_t now() noexcept;
+
+        void sweep_impl(ScopedLock &lock);
+
+        time_us_t idleTimeout;
+
+        // Last activity of each slot, in microseconds, padded to
+        // whole blocks of 64 slots. It never moves, so touch() can
+        // use it without locking
+        std::unique_ptr<std::atomic<std::int64_t>[]> lastActivity;
+        std::size_t                                  slotCapacity;
+
+        // Slots ever opened, the sweep stops there
+        std::size_t slots;
+        std::size_t openSlots;
+
+        // Closed slots, reused by open()
+        std::vector<slot_t> freeSlots;
+
+        expiry_handler_type handler;
+
+        mutable Lock            sync;
+        TimerThread            &timerThread;
+        TimerThread::timer_id_t sweeper;
+};
+
+#endif /* IDLESWEEPER_HXX */
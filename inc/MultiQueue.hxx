@@ -0,0 +1,328 @@
+/**
+ * MultiQueue class definition
+ *
+ * @file MultiQueue.hxx
+ */
+
+#ifndef MULTIQUEUE_HXX
+#define MULTIQUEUE_HXX
+
+/* Includes -------------------------------------------- */
+#include "TimerLock.hxx"
+
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstddef>
+
+/* Defines --------------------------------------------- */
+#ifndef TIMER_MULTIQUEUE_FACTOR
+#define TIMER_MULTIQUEUE_FACTOR 2 /* Heaps of the MultiQueue per hardware thread */
+#endif /* TIMER_MULTIQUEUE_FACTOR */
+
+#ifndef TIMER_MULTIQUEUE_CHOICES
+#define TIMER_MULTIQUEUE_CHOICES 2 /* Heads of the MultiQueue compared per pop */
+#endif /* TIMER_MULTIQUEUE_CHOICES */
+
+/* MultiQueue class definition ------------------------- */
+/** @brief Relaxed priority queue shared by many producers and one consumer
+ *
+ * The entries are spread over many heaps, each behind its own
+ * TimerSpinLock. An entry goes to the heap selected by a hash of
+ * its ID, so concurrent producers rarely hit the same heap, and a
+ * cancellation knows where to look.
+ *
+ * The consumer compares the heads of `choices` heaps picked at
+ * random, and pops the earliest one. The entries come out roughly,
+ * but not strictly, in order: the more choices, the closer to the
+ * exact order, which is reached when all the heaps are compared.
+ * When none of the sampled heads is due, all the heads are
+ * compared, so the due entries are never left behind.
+ *
+ * Entries taken out are only dropped from the index of their heap,
+ * and their slot is skipped when it comes out of the heap. A heap is
+ * rebuilt once most of its slots are dropped.
+ *
+ * T must be default constructible, movable, and have an `id`
+ * (unique) and a `next` (std::chrono::time_point) member.
+ */
+template<typename T>
+class MultiQueue
+{
+    public:
+        using id_type   = decltype(T::id);
+        using Timestamp = decltype(T::next);
+
+        /** @brief Constructor allocates `heaps` heaps */
+        explicit MultiQueue(std::size_t heaps);
+
+        // Never called
+        MultiQueue(MultiQueue const &r)            = delete;
+        MultiQueue &operator=(MultiQueue const &r) = delete;
+
+        /** @brief Insert an entry, from any thread */
+        void insert(T &&entry);
+
+        /** @brief Take an entry out before it is popped, from any thread
+         *
+         * @return false if there is no such entry
+         */
+        bool take(id_type id, T &entry);
+
+        /** @brief Pop the entries due at `now`, consumer only
+         * `fn` is called with each of them, roughly in order. All the
+         * due entries are popped, unless inserted meanwhile
+         */
+        template<typename F>
+        void pop(Timestamp now, std::size_t choices, F fn);
+
+        /** @brief Earliest head of the heaps, Timestamp::max() if empty */
+        Timestamp next() const noexcept;
+
+        /** @brief Drop all the entries */
+        void clear();
+
+        /* Peek at current state */
+        std::size_t size() const;
+        std::size_t heaps() const noexcept;
+
+    private:
+        using ScopedLock = std::unique_lock<TimerSpinLock>;
+
+        struct Slot {
+            Timestamp due;
+            id_type   id;
+
+            // Earliest first in a std heap
+            bool operator<(Slot const &r) const noexcept
+            {
+                return (r.due < due) || ((r.due == due) && (r.id < id));
+            }
+        };
+
+        struct alignas(64) Heap {
+            TimerSpinLock                  sync;
+            std::vector<Slot>              slots;
+            std::unordered_map<id_type, T> entries;
+            std::size_t                    dropped = 0U; /* Slots left by the entries taken out */
+            std::atomic<Timestamp>         top;          /* Due time of the first slot, read without the lock */
+        };
+
+        Heap &heapOf(id_type id) const noexcept;
+        void  update(Heap &heap) noexcept;
+        std::size_t pick() noexcept;
+
+        std::size_t const       count;
+        std::unique_ptr<Heap[]> queues;
+
+        // Random source of the consumer
+        std::uint64_t seed;
+};
+
+/* Template implementation of class methods */
+template<typename T>
+MultiQueue<T>::MultiQueue(std::size_t heaps)
+    : count(std::max<std::size_t>(heaps, 1U)),
+    queues(new Heap[std::max<std::size_t>(heaps, 1U)]),
+    seed(0x9e3779b97f4a7c15ULL)
+{
+    for (std::size_t i = 0U; i < count; ++i) {
+        queues[i].top.store(Timestamp::max(), std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+void MultiQueue<T>::insert(T &&entry)
+{
+    Heap      &heap = heapOf(entry.id);
+    ScopedLock lock(heap.sync);
+
+    heap.slots.push_back(Slot{entry.next, entry.id});
+    std::push_heap(heap.slots.begin(), heap.slots.end());
+    heap.entries.emplace(entry.id, std::move(entry));
+
+    update(heap);
+}
+
+template<typename T>
+bool MultiQueue<T>::take(id_type id, T &entry)
+{
+    Heap      &heap = heapOf(id);
+    ScopedLock lock(heap.sync);
+    auto       i = heap.entries.find(id);
+
+    if (i == heap.entries.end()) {
+        return false;
+    }
+
+    entry = std::move(i->second);
+    heap.entries.erase(i);
+    ++heap.dropped;
+
+    // Rebuild the heap once most of its slots are dropped
+    if (heap.dropped > heap.entries.size()) {
+        auto keep = std::remove_if(heap.slots.begin(), heap.slots.end(),
+                                    [&heap](Slot const &slot) {
+                                        return 0U == heap.entries.count(slot.id);
+                                    });
+
+        heap.slots.erase(keep, heap.slots.end());
+        std::make_heap(heap.slots.begin(), heap.slots.end());
+        heap.dropped = 0U;
+
+        update(heap);
+    }
+
+    return true;
+}
+
+template<typename T>
+template<typename F>
+void MultiQueue<T>::pop(Timestamp now, std::size_t choices, F fn)
+{
+    bool const exact = (choices >= count);
+
+    while (true) {
+        std::size_t best = exact ? 0U : pick();
+        Timestamp   due  = queues[best].top.load();
+
+        for (std::size_t c = 1U; c < (exact ? count : choices); ++c) {
+            std::size_t const i   = exact ? c : pick();
+            Timestamp const   top = queues[i].top.load();
+
+            if (top < due) {
+                best = i;
+                due  = top;
+            }
+        }
+
+        // The sampled heads are not due, but another one may be:
+        // pick the earliest of all, so that pop() leaves no due
+        // entry and next() never tells to come back right away
+        for (std::size_t i = 0U; !exact && (due > now) && (i < count); ++i) {
+            Timestamp const top = queues[i].top.load();
+
+            if (top < due) {
+                best = i;
+                due  = top;
+            }
+        }
+
+        if (due > now) {
+            return;
+        }
+
+        Heap &heap  = queues[best];
+        T     entry;
+        bool  found = false;
+
+        {
+            ScopedLock lock(heap.sync);
+
+            while (!found && !heap.slots.empty() && (heap.slots.front().due <= now)) {
+                std::pop_heap(heap.slots.begin(), heap.slots.end());
+
+                auto i = heap.entries.find(heap.slots.back().id);
+
+                heap.slots.pop_back();
+
+                if (i == heap.entries.end()) {
+                    --heap.dropped;
+                    continue;
+                }
+
+                entry = std::move(i->second);
+                heap.entries.erase(i);
+                found = true;
+            }
+
+            update(heap);
+        }
+
+        if (found) {
+            fn(std::move(entry));
+        }
+    }
+}
+
+template<typename T>
+typename MultiQueue<T>::Timestamp MultiQueue<T>::next() const noexcept
+{
+    Timestamp next = Timestamp::max();
+
+    for (std::size_t i = 0U; i < count; ++i) {
+        next = std::min(next, queues[i].top.load());
+    }
+
+    return next;
+}
+
+template<typename T>
+void MultiQueue<T>::clear()
+{
+    for (std::size_t i = 0U; i < count; ++i) {
+        ScopedLock lock(queues[i].sync);
+
+        queues[i].slots.clear();
+        queues[i].entries.clear();
+        queues[i].dropped = 0U;
+
+        update(queues[i]);
+    }
+}
+
+template<typename T>
+std::size_t MultiQueue<T>::size() const
+{
+    std::size_t lSize = 0U;
+
+    for (std::size_t i = 0U; i < count; ++i) {
+        ScopedLock lock(queues[i].sync);
+        lSize += queues[i].entries.size();
+    }
+
+    return lSize;
+}
+
+template<typename T>
+std::size_t MultiQueue<T>::heaps() const noexcept
+{
+    return count;
+}
+
+template<typename T>
+typename MultiQueue<T>::Heap &MultiQueue<T>::heapOf(id_type id) const noexcept
+{
+    // Consecutive IDs land on unrelated heaps
+    std::uint64_t hash = static_cast<std::uint64_t>(id) * 0x9e3779b97f4a7c15ULL;
+
+    return queues[static_cast<std::size_t>(hash >> 32U) % count];
+}
+
+// NOTE: called with the heap's lock held. Sequentially consistent,
+// so that either the consumer sees the new head before it sleeps,
+// or the producer sees when the consumer sleeps until
+template<typename T>
+void MultiQueue<T>::update(Heap &heap) noexcept
+{
+    heap.top.store(heap.slots.empty() ? Timestamp::max() : heap.slots.front().due);
+}
+
+template<typename T>
+std::size_t MultiQueue<T>::pick() noexcept
+{
+    // xorshift64
+    seed ^= seed << 13U;
+    seed ^= seed >> 7U;
+    seed ^= seed << 17U;
+
+    return static_cast<std::size_t>(seed % count);
+}
+
+#endif /* MULTIQUEUE_HXX */
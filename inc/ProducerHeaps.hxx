@@ -0,0 +1,448 @@
+/**
+ * ProducerHeaps class definition
+ *
+ * @file ProducerHeaps.hxx
+ */
+
+#ifndef PRODUCERHEAPS_HXX
+#define PRODUCERHEAPS_HXX
+
+/* Includes -------------------------------------------- */
+#include "TimerLock.hxx"
+#include "ThreadExit.hxx"
+
+#include <unordered_map>
+#include <functional>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstddef>
+
+/* Defines --------------------------------------------- */
+#ifndef TIMER_PRODUCER_SLOTS
+#define TIMER_PRODUCER_SLOTS 64 /* Producer threads with their own heap, a power of 2 */
+#endif /* TIMER_PRODUCER_SLOTS */
+
+/* ProducerHeaps class definition ---------------------- */
+/** @brief Priority queue made of one heap per producer thread
+ *
+ * A producer thread registers in a slot the first time it inserts
+ * an entry, and owns the heap of this slot from then on. Only the
+ * owner inserts into its heap, and only the consumer pops from it,
+ * so producers never contend with each other. The TimerSpinLock of
+ * the heap is only contended between its owner and the consumer.
+ *
+ * The owner publishes the head of its heap, and flags the slot as
+ * changed. The consumer keeps a tournament tree over the heads: it
+ * only replays the matches of the slots that changed, and the root
+ * is the earliest entry of all the heaps.
+ *
+ * take() only looks in the heap of the calling thread. The entries
+ * of the other heaps are taken by the consumer, with claim(). Other
+ * threads can check that they are there first, with contains().
+ *
+ * When all the slots are taken, insert() refuses the entries of
+ * the threads without one. A slot is released when its thread
+ * exits, and the next thread registering in it takes its heap
+ * over, with the entries still in it.
+ *
+ * T must be default constructible, movable, and have an `id`
+ * (unique) and a `next` (std::chrono::time_point) member.
+ */
+template<typename T>
+class ProducerHeaps
+{
+    public:
+        using id_type   = decltype(T::id);
+        using Timestamp = decltype(T::next);
+
+        /** @brief Constructor allocates TIMER_PRODUCER_SLOTS slots */
+        explicit ProducerHeaps();
+
+        // Never called
+        ProducerHeaps(ProducerHeaps const &r)            = delete;
+        ProducerHeaps &operator=(ProducerHeaps const &r) = delete;
+
+        /** @brief Insert an entry into the heap of the calling thread
+         *
+         * @return false if all the slots are taken, it is left untouched
+         */
+        bool insert(T &entry);
+
+        /** @brief Take an entry of the calling thread out before it is popped
+         *
+         * @return false if it is not in the heap of the calling thread
+         */
+        bool take(id_type id, T &entry);
+
+        /** @brief Whether any heap holds an entry, from any thread */
+        bool contains(id_type id) const;
+
+        /** @brief Take an entry out of any heap, consumer only
+         *
+         * @return false if there is no such entry
+         */
+        bool claim(id_type id, T &entry);
+
+        /** @brief Pop the entries due at `now` in order, consumer only
+         * `fn` is called with each of them
+         */
+        template<typename F>
+        void pop(Timestamp now, F fn);
+
+        /** @brief Earliest entry of the heaps, consumer only
+         * Timestamp::max() if they are empty
+         */
+        Timestamp next();
+
+        /** @brief Drop all the entries */
+        void clear();
+
+        /* Peek at current state */
+        std::size_t size() const;
+        std::size_t producers() const noexcept;
+
+    private:
+        using ScopedLock = std::unique_lock<TimerSpinLock>;
+
+        struct Node {
+            Timestamp due;
+            id_type   id;
+
+            // Earliest first in a std heap
+            bool operator<(Node const &r) const noexcept
+            {
+                return (r.due < due) || ((r.due == due) && (r.id < id));
+            }
+        };
+
+        struct alignas(64) Slot {
+            std::atomic<bool>              used;         /* Whether a thread ever registered */
+            TimerSpinLock                  sync;
+            std::vector<Node>              heap;
+            std::unordered_map<id_type, T> entries;
+            std::size_t                    dropped = 0U; /* Nodes left by the entries taken out */
+            std::atomic<Timestamp>         top;          /* Due time of the first node */
+            std::atomic<bool>              changed;      /* Whether `top` changed since the consumer read it */
+        };
+
+        Slot *slotOf(std::thread::id thread, bool reg);
+        void  publish(Slot &slot) noexcept;
+        void  refresh();
+        void  replay(std::size_t leaf);
+
+        std::unique_ptr<Slot[]> slots;
+
+        // Thread of each slot, apart from the slots so that the
+        // threads can still release theirs when they exit, if
+        // the ProducerHeaps is alive
+        std::shared_ptr<std::atomic<std::thread::id>[]> owners;
+
+        // Tournament tree of the consumer, node n plays the winners
+        // of 2n and 2n + 1, leaf i is TIMER_PRODUCER_SLOTS + i
+        std::vector<Timestamp>   heads;
+        std::vector<std::size_t> winners;
+};
+
+/* Template implementation of class methods */
+template<typename T>
+ProducerHeaps<T>::ProducerHeaps()
+    : slots(new Slot[TIMER_PRODUCER_SLOTS]),
+    owners(new std::atomic<std::thread::id>[TIMER_PRODUCER_SLOTS]),
+    heads(TIMER_PRODUCER_SLOTS, Timestamp::max()),
+    winners(2U * TIMER_PRODUCER_SLOTS, 0U)
+{
+    static_assert(0U == (TIMER_PRODUCER_SLOTS & (TIMER_PRODUCER_SLOTS - 1U)),
+                    "TIMER_PRODUCER_SLOTS must be a power of 2");
+
+    for (std::size_t i = 0U; i < TIMER_PRODUCER_SLOTS; ++i) {
+        slots[i].used.store(false, std::memory_order_relaxed);
+        owners[i].store(std::thread::id(), std::memory_order_relaxed);
+        slots[i].top.store(Timestamp::max(), std::memory_order_relaxed);
+        slots[i].changed.store(false, std::memory_order_relaxed);
+        winners[TIMER_PRODUCER_SLOTS + i] = i;
+    }
+
+    for (std::size_t n = TIMER_PRODUCER_SLOTS - 1U; n > 0U; --n) {
+        winners[n] = winners[2U * n];
+    }
+}
+
+template<typename T>
+bool ProducerHeaps<T>::insert(T &entry)
+{
+    Slot *slot = slotOf(std::this_thread::get_id(), true);
+
+    if (nullptr == slot) {
+        return false;
+    }
+
+    id_type const id = entry.id;
+    ScopedLock    lock(slot->sync);
+
+    slot->heap.push_back(Node{entry.next, id});
+    std::push_heap(slot->heap.begin(), slot->heap.end());
+    slot->entries.emplace(id, std::move(entry));
+
+    // The consumer only needs to know about a new head
+    if (slot->heap.front().id == id) {
+        publish(*slot);
+    }
+
+    return true;
+}
+
+template<typename T>
+bool ProducerHeaps<T>::take(id_type id, T &entry)
+{
+    Slot *slot = slotOf(std::this_thread::get_id(), false);
+
+    if (nullptr == slot) {
+        return false;
+    }
+
+    ScopedLock lock(slot->sync);
+    auto       i = slot->entries.find(id);
+
+    if (i == slot->entries.end()) {
+        return false;
+    }
+
+    entry = std::move(i->second);
+    slot->entries.erase(i);
+    ++slot->dropped;
+
+    // Rebuild the heap once most of its nodes are dropped
+    if (slot->dropped > slot->entries.size()) {
+        auto keep = std::remove_if(slot->heap.begin(), slot->heap.end(),
+                                    [slot](Node const &node) {
+                                        return 0U == slot->entries.count(node.id);
+                                    });
+
+        slot->heap.erase(keep, slot->heap.end());
+        std::make_heap(slot->heap.begin(), slot->heap.end());
+        slot->dropped = 0U;
+
+        publish(*slot);
+    }
+
+    return true;
+}
+
+template<typename T>
+bool ProducerHeaps<T>::claim(id_type id, T &entry)
+{
+    // The dropped node is skipped when it is popped
+    for (std::size_t s = 0U; s < TIMER_PRODUCER_SLOTS; ++s) {
+        Slot &slot = slots[s];
+
+        if (!slot.used.load(std::memory_order_acquire)) {
+            continue;
+        }
+
+        ScopedLock lock(slot.sync);
+        auto       i = slot.entries.find(id);
+
+        if (i != slot.entries.end()) {
+            entry = std::move(i->second);
+            slot.entries.erase(i);
+            ++slot.dropped;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template<typename T>
+bool ProducerHeaps<T>::contains(id_type id) const
+{
+    for (std::size_t s = 0U; s < TIMER_PRODUCER_SLOTS; ++s) {
+        Slot &slot = slots[s];
+
+        if (!slot.used.load(std::memory_order_acquire)) {
+            continue;
+        }
+
+        ScopedLock lock(slot.sync);
+
+        if (0U < slot.entries.count(id)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template<typename T>
+template<typename F>
+void ProducerHeaps<T>::pop(Timestamp now, F fn)
+{
+    refresh();
+
+    while (heads[winners[1U]] <= now) {
+        std::size_t const s     = winners[1U];
+        Slot             &slot  = slots[s];
+        T                 entry;
+        bool              found = false;
+
+        {
+            ScopedLock lock(slot.sync);
+
+            while (!found && !slot.heap.empty() && (slot.heap.front().due <= now)) {
+                std::pop_heap(slot.heap.begin(), slot.heap.end());
+
+                auto i = slot.entries.find(slot.heap.back().id);
+
+                slot.heap.pop_back();
+
+                if (i == slot.entries.end()) {
+                    --slot.dropped;
+                    continue;
+                }
+
+                entry = std::move(i->second);
+                slot.entries.erase(i);
+                found = true;
+            }
+
+            // Read back by the consumer right away
+            publish(slot);
+            slot.changed.store(false, std::memory_order_relaxed);
+            heads[s] = slot.top.load(std::memory_order_relaxed);
+        }
+
+        replay(s);
+
+        if (found) {
+            fn(std::move(entry));
+        }
+    }
+}
+
+template<typename T>
+typename ProducerHeaps<T>::Timestamp ProducerHeaps<T>::next()
+{
+    refresh();
+
+    return heads[winners[1U]];
+}
+
+template<typename T>
+void ProducerHeaps<T>::clear()
+{
+    for (std::size_t s = 0U; s < TIMER_PRODUCER_SLOTS; ++s) {
+        ScopedLock lock(slots[s].sync);
+
+        slots[s].heap.clear();
+        slots[s].entries.clear();
+        slots[s].dropped = 0U;
+
+        publish(slots[s]);
+    }
+}
+
+template<typename T>
+std::size_t ProducerHeaps<T>::producers() const noexcept
+{
+    std::size_t lProducers = 0U;
+
+    for (std::size_t s = 0U; s < TIMER_PRODUCER_SLOTS; ++s) {
+        if (std::thread::id() != owners[s].load(std::memory_order_relaxed)) {
+            ++lProducers;
+        }
+    }
+
+    return lProducers;
+}
+
+template<typename T>
+std::size_t ProducerHeaps<T>::size() const
+{
+    std::size_t lSize = 0U;
+
+    for (std::size_t s = 0U; s < TIMER_PRODUCER_SLOTS; ++s) {
+        ScopedLock lock(slots[s].sync);
+        lSize += slots[s].entries.size();
+    }
+
+    return lSize;
+}
+
+// Finds the slot of a thread, and registers it in a free one if `reg`.
+// The slot is released when the thread exits
+template<typename T>
+typename ProducerHeaps<T>::Slot *ProducerHeaps<T>::slotOf(std::thread::id thread, bool reg)
+{
+    std::size_t const first = std::hash<std::thread::id>()(thread);
+
+    for (std::size_t p = 0U; p < TIMER_PRODUCER_SLOTS; ++p) {
+        std::size_t const             s     = (first + p) & (TIMER_PRODUCER_SLOTS - 1U);
+        std::atomic<std::thread::id> &owner = owners[s];
+        std::thread::id               found = owner.load(std::memory_order_acquire);
+
+        if (found == thread) {
+            return &slots[s];
+        }
+
+        if ((std::thread::id() == found) && reg
+            && owner.compare_exchange_strong(found, thread, std::memory_order_acq_rel))
+        {
+            slots[s].used.store(true, std::memory_order_release);
+
+            ThreadExit::atExit(owners,
+                                [&owner, thread]() {
+                                    std::thread::id lThread = thread;
+
+                                    owner.compare_exchange_strong(lThread, std::thread::id(), std::memory_order_acq_rel);
+                                });
+
+            return &slots[s];
+        }
+    }
+
+    return nullptr;
+}
+
+// NOTE: called with the slot's lock held. Sequentially consistent,
+// so that either the consumer sees the new head before it sleeps,
+// or the producer sees when the consumer sleeps until
+template<typename T>
+void ProducerHeaps<T>::publish(Slot &slot) noexcept
+{
+    slot.top.store(slot.heap.empty() ? Timestamp::max() : slot.heap.front().due);
+    slot.changed.store(true);
+}
+
+// Reads back the heads of the slots that changed
+template<typename T>
+void ProducerHeaps<T>::refresh()
+{
+    for (std::size_t s = 0U; s < TIMER_PRODUCER_SLOTS; ++s) {
+        if (slots[s].changed.exchange(false)) {
+            heads[s] = slots[s].top.load();
+            replay(s);
+        }
+    }
+}
+
+// Plays the matches from a leaf up to the root
+template<typename T>
+void ProducerHeaps<T>::replay(std::size_t leaf)
+{
+    for (std::size_t n = (TIMER_PRODUCER_SLOTS + leaf) / 2U; n > 0U; n /= 2U) {
+        std::size_t const a = winners[2U * n];
+        std::size_t const b = winners[2U * n + 1U];
+
+        winners[n] = (heads[b] < heads[a]) ? b : a;
+    }
+}
+
+#endif /* PRODUCERHEAPS_HXX */
@@ -0,0 +1,41 @@
+/**
+ * ThreadExit class definition
+ *
+ * @file ThreadExit.hxx
+ */
+
+#ifndef THREADEXIT_HXX
+#define THREADEXIT_HXX
+
+/* Includes -------------------------------------------- */
+#include <functional>
+#include <memory>
+
+/* ThreadExit class definition ------------------------- */
+/** @brief Calls handlers when the calling thread exits
+ *
+ * Lets a shared structure release what it keeps for a thread,
+ * such as a per-thread slot, once that thread is gone. Each
+ * handler is tied to the lifetime of an owner object: it is only
+ * called if its owner is still alive when the thread exits, and
+ * the owner is kept alive while it runs.
+ */
+class ThreadExit
+{
+    public:
+        /* Defining the handler type */
+        using handler_type = std::function<void()>;
+
+        /** @brief Call `handler` when the calling thread exits,
+         * unless `owner` is destroyed by then. The handlers of the
+         * owners already destroyed are dropped as new ones come in
+         */
+        static void atExit(std::weak_ptr<void> owner, handler_type handler);
+
+        // Never called
+        ThreadExit()                               = delete;
+        ThreadExit(ThreadExit const &r)            = delete;
+        ThreadExit &operator=(ThreadExit const &r) = delete;
+};
+
+#endif /* THREADEXIT_HXX */
@@ -0,0 +1,127 @@
+/**
+ * TimerBatch class definition
+ *
+ * @file TimerBatch.hxx
+ */
+
+#ifndef TIMERBATCH_HXX
+#define TIMERBATCH_HXX
+
+/* Includes -------------------------------------------- */
+#include "TimerThread.hxx"
+
+#include <vector>
+
+#include <cstddef>
+
+/* Defines --------------------------------------------- */
+#ifndef TIMER_BATCH_SIZE
+#define TIMER_BATCH_SIZE 64 /* Buffered operations that trigger a flush */
+#endif /* TIMER_BATCH_SIZE */
+
+#ifndef TIMER_BATCH_AGE
+#define TIMER_BATCH_AGE 1000 /* Age of the oldest buffered operation that triggers a flush, in microseconds */
+#endif /* TIMER_BATCH_AGE */
+
+/* TimerBatch class definition ------------------------- */
+/** @brief Producer-side buffer of TimerThread operations
+ *
+ * addTimer and clearTimer calls are buffered, and published to
+ * the TimerThread by a flush, which takes its lock once for the
+ * whole batch. Meant for event loops creating many timers per
+ * iteration, which flush at the end of each iteration.
+ *
+ * A flush also happens when `maxOps` operations are buffered, or
+ * when an operation is buffered more than `maxAge` microseconds
+ * after the oldest one. A zero limit disables it. The age is only
+ * checked when an operation is buffered: nothing flushes a batch
+ * by age on its own, so a lone buffered operation waits for the
+ * next one, or for flush().
+ *
+ * The IDs are reserved from the TimerThread right away, and the
+ * deadlines are computed when the operations are buffered. A
+ * timer that is added then cleared before the flush never
+ * reaches the TimerThread.
+ *
+ * A TimerBatch is not thread safe, each producer thread uses its
+ * own, for instance local(). It must not outlive its TimerThread.
+ */
+class TimerBatch
+{
+    public:
+        /* Defining the types of the TimerThread */
+        using timer_id_t   = TimerThread::timer_id_t;
+        using time_us_t    = TimerThread::time_us_t;
+        using handler_type = TimerThread::handler_type;
+
+        /** @brief Constructor buffering operations on `timerThread` */
+        explicit TimerBatch(std::size_t  maxOps      = TIMER_BATCH_SIZE,
+                            time_us_t    maxAge      = TIMER_BATCH_AGE,
+                            TimerThread &timerThread = TimerThread::global());
+
+        /** @brief Destructor flushes the buffered operations */
+        ~TimerBatch();
+
+        // Never called
+        TimerBatch(TimerBatch const &r)            = delete;
+        TimerBatch &operator=(TimerBatch const &r) = delete;
+
+        /** @brief Buffer the creation of a timer, see TimerThread::addTimer
+         * The timer fires msDelay microseconds from now, even if
+         * the batch is flushed later
+         */
+        timer_id_t addTimer(time_us_t    msDelay,
+                            time_us_t    msPeriod,
+                            handler_type handler);
+
+        /** @brief setInterval API like browser javascript */
+        timer_id_t setInterval(handler_type handler,
+                                time_us_t    msPeriod);
+
+        /** @brief setTimeout API like browser javascript */
+        timer_id_t setTimeout(handler_type handler,
+                                time_us_t    msDelay);
+
+        /** @brief Buffer the destruction of a timer, see TimerThread::clearTimer
+         *
+         * @return true if the timer was added by this batch since
+         * the last flush, and is dropped. Otherwise, it is cleared
+         * by the next flush
+         */
+        bool clearTimer(timer_id_t id);
+
+        /** @brief Publish the buffered operations to the TimerThread
+         * Like clearTimer, it waits for the handlers of the cleared
+         * timers that are running
+         */
+        void flush();
+
+        /* Peek at current state */
+        std::size_t size() const noexcept;
+        bool        empty() const noexcept;
+
+        /** @brief Returns the calling thread's batch on TimerThread::global() */
+        static TimerBatch &local();
+
+    private:
+        using Submission = TimerThread::Submission;
+        using Clock      = TimerThread::Clock;
+        using Timestamp  = TimerThread::Timestamp;
+        using Duration   = TimerThread::Duration;
+
+        void buffered_impl(Timestamp now);
+
+        std::size_t maxOps;
+        Duration    maxAge;
+
+        // Buffered operations, the adds are sorted by ID
+        std::vector<Submission> adds;
+        std::vector<timer_id_t> clears;
+
+        // When the oldest operation was buffered
+        Timestamp oldest;
+
+        TimerThread &timerThread;
+};
+
+#endif /* TIMERBATCH_HXX */
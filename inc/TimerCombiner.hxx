@@ -0,0 +1,210 @@
+/**
+ * TimerCombiner class definition
+ *
+ * @file TimerCombiner.hxx
+ */
+
+#ifndef TIMERCOMBINER_HXX
+#define TIMERCOMBINER_HXX
+
+/* Includes -------------------------------------------- */
+#include "ThreadExit.hxx"
+
+#include <functional>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+#include <cstddef>
+
+/* Defines --------------------------------------------- */
+#ifndef TIMER_COMBINING_SLOTS
+#define TIMER_COMBINING_SLOTS 64 /* Threads with a request record for flat combining, a power of 2 */
+#endif /* TIMER_COMBINING_SLOTS */
+
+/* TimerCombiner class definition ---------------------- */
+/** @brief Request records of flat combining
+ *
+ * Instead of taking a lock, each thread posts its operation into its
+ * own record, and tries the lock. The thread that gets it applies all
+ * the posted operations, and hands the results back through the
+ * records, while the others wait for them. Under heavy contention,
+ * the lock changes hands once for many operations.
+ *
+ * Only TIMER_COMBINING_SLOTS live threads get a record, a thread
+ * keeps it until it exits. A record is only filled and read by its
+ * thread, and applied by the combiner.
+ *
+ * Op holds an operation and its result, and must be default
+ * constructible.
+ */
+template<typename Op>
+class TimerCombiner
+{
+    public:
+        enum class State {
+            Idle,   /* Nothing posted */
+            Posted, /* Waiting for a combiner */
+            Done,   /* Applied, the result is in the record */
+            Retry   /* Left to the thread that posted it */
+        };
+
+        // Record of a thread
+        struct alignas(64) Record {
+            std::atomic<std::thread::id> thread{std::thread::id()};
+            std::atomic<State>           state{State::Idle};
+            Op                           op;
+        };
+
+        /** @brief Constructor, the records are allocated once enabled */
+        explicit TimerCombiner();
+
+        // Never called
+        TimerCombiner(TimerCombiner const &r)            = delete;
+        TimerCombiner &operator=(TimerCombiner const &r) = delete;
+
+        /** @brief Enable or disable flat combining, with the lock held */
+        void enable(bool enabled);
+
+        /** @brief Whether flat combining is enabled, from any thread */
+        bool enabled() const noexcept;
+
+        /** @brief Record of the calling thread, registering it in a
+         * free one, or nullptr if they are all taken. The record is
+         * released when the thread exits
+         */
+        Record *record();
+
+        /** @brief Post the operation of `record`, and wait until it is
+         * applied. Whenever the calling thread gets `sync`, it calls
+         * `combine`, which must apply() the posted operations and
+         * release `sync`. The record is Idle again once it returns
+         *
+         * @return Done, or Retry if the operation was left to the
+         * calling thread
+         */
+        template<typename L, typename F>
+        State post(Record &record, L &sync, F combine);
+
+        /** @brief Apply the posted operations, with the lock held.
+         * `fn` is called with each of them, and returns false to
+         * leave it to its thread
+         */
+        template<typename F>
+        void apply(F fn);
+
+    private:
+#ifdef TEST
+        friend class TimerThreadTest;
+#endif /* TEST */
+
+        // Shared with the threads, which release theirs when they exit
+        std::shared_ptr<Record[]> records;
+
+        // Records posted, so that combiners stop looking early
+        std::atomic<std::ptrdiff_t> posted;
+        std::atomic<bool>           combining;
+};
+
+/* Template implementation of class methods */
+template<typename Op>
+TimerCombiner<Op>::TimerCombiner()
+    : records(),
+    posted(0),
+    combining(false)
+{
+    static_assert(0U == (TIMER_COMBINING_SLOTS & (TIMER_COMBINING_SLOTS - 1U)),
+                    "TIMER_COMBINING_SLOTS must be a power of 2");
+}
+
+template<typename Op>
+void TimerCombiner<Op>::enable(bool enabled)
+{
+    if (enabled && !records) {
+        records.reset(new Record[TIMER_COMBINING_SLOTS]);
+    }
+
+    combining.store(enabled, std::memory_order_release);
+}
+
+template<typename Op>
+bool TimerCombiner<Op>::enabled() const noexcept
+{
+    return combining.load(std::memory_order_acquire);
+}
+
+template<typename Op>
+typename TimerCombiner<Op>::Record *TimerCombiner<Op>::record()
+{
+    std::thread::id const thread = std::this_thread::get_id();
+    std::size_t const     first  = std::hash<std::thread::id>()(thread);
+
+    for (std::size_t p = 0U; p < TIMER_COMBINING_SLOTS; ++p) {
+        Record         &lRecord = records[(first + p) & (TIMER_COMBINING_SLOTS - 1U)];
+        std::thread::id owner   = lRecord.thread.load(std::memory_order_acquire);
+
+        if (owner == thread) {
+            return &lRecord;
+        }
+
+        if ((std::thread::id() == owner)
+            && lRecord.thread.compare_exchange_strong(owner, thread, std::memory_order_acq_rel))
+        {
+            ThreadExit::atExit(records,
+                                [&lRecord, thread]() {
+                                    std::thread::id lThread = thread;
+
+                                    lRecord.thread.compare_exchange_strong(lThread, std::thread::id(), std::memory_order_acq_rel);
+                                });
+
+            return &lRecord;
+        }
+    }
+
+    return nullptr;
+}
+
+template<typename Op>
+template<typename L, typename F>
+typename TimerCombiner<Op>::State TimerCombiner<Op>::post(Record &record, L &sync, F combine)
+{
+    record.state.store(State::Posted, std::memory_order_release);
+    posted.fetch_add(1, std::memory_order_release);
+
+    while (State::Posted == record.state.load(std::memory_order_acquire)) {
+        if (!sync.try_lock()) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        combine();
+    }
+
+    return record.state.exchange(State::Idle, std::memory_order_relaxed);
+}
+
+template<typename Op>
+template<typename F>
+void TimerCombiner<Op>::apply(F fn)
+{
+    std::ptrdiff_t applied = 0;
+
+    // A record may be applied before it is counted, then
+    // the count catches up when its thread increments it
+    std::ptrdiff_t const count = posted.load(std::memory_order_acquire);
+
+    for (std::size_t r = 0U; (r < TIMER_COMBINING_SLOTS) && (applied < count); ++r) {
+        Record &lRecord = records[r];
+
+        if (State::Posted != lRecord.state.load(std::memory_order_acquire)) {
+            continue;
+        }
+
+        lRecord.state.store(fn(lRecord.op) ? State::Done : State::Retry, std::memory_order_release);
+        ++applied;
+    }
+
+    posted.fetch_sub(applied, std::memory_order_relaxed);
+}
+
+#endif /* TIMERCOMBINER_HXX */
@@ -0,0 +1,72 @@
+/**
+ * TimerDomain class definition
+ *
+ * @file TimerDomain.hxx
+ */
+
+#ifndef TIMERDOMAIN_HXX
+#define TIMERDOMAIN_HXX
+
+/* Includes -------------------------------------------- */
+#include "TimerThread.hxx"
+
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include <cstddef>
+
+/* TimerDomain class definition ------------------------ */
+/** @brief Workers shared by several TimerThreads
+ *
+ * Each standalone TimerThread spawns its own worker. A
+ * TimerThread constructed with a TimerDomain instead runs its
+ * timers on one of the domain's workers, so many TimerThreads
+ * (one per module for instance) only cost one worker, or a
+ * small pool of workers.
+ *
+ * TimerThreads are attached to the workers of the pool in turn.
+ * Each worker still starts with its first timer.
+ *
+ * The domain must outlive the TimerThreads attached to it.
+ */
+class TimerDomain
+{
+    public:
+        /** @brief Constructor does not start any worker
+         * until there is a Timer
+         * `lockPolicy` applies to the locks of all the workers
+         */
+        explicit TimerDomain(std::size_t             workers    = 1U,
+                                TimerThread::LockPolicy lockPolicy = TimerThread::LockPolicy::Blocking);
+
+        /** @brief Destructor stops the workers. All callbacks are
+         * guaranteed to have returned before it returns
+         */
+        ~TimerDomain();
+
+        // Never called
+        TimerDomain(TimerDomain const &r)            = delete;
+        TimerDomain &operator=(TimerDomain const &r) = delete;
+
+        /* @brief Set the priority of all the domain's workers
+         */
+        int setScheduling(const int &pPolicy, const int &pPriority);
+
+        /* Peek at current state */
+        std::size_t workers() const noexcept;
+        std::size_t size() const noexcept;
+
+    private:
+        friend class TimerThread;
+
+        /** @brief Engine for a newly attached TimerThread */
+        TimerThread *attach() noexcept;
+
+        // Each engine is a TimerThread running the timers
+        // of the TimerThreads attached to it
+        std::vector<std::unique_ptr<TimerThread>> engines;
+        std::atomic<std::size_t>                  nextEngine;
+};
+
+#endif /* TIMERDOMAIN_HXX */
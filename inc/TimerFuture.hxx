@@ -0,0 +1,407 @@
+/**
+ * TimerFuture and TimerPromise class definitions
+ *
+ * @file TimerFuture.hxx
+ */
+
+#ifndef TIMERFUTURE_HXX
+#define TIMERFUTURE_HXX
+
+/* Includes -------------------------------------------- */
+#include "TimerThread.hxx"
+
+#include <functional>
+#include <condition_variable>
+#include <optional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#include <chrono>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define TIMER_FUTURE_COROUTINES 1
+#endif /* __has_include(<coroutine>) */
+#endif /* __cpp_impl_coroutine */
+
+/* Completion status ----------------------------------- */
+/** @brief Status of a TimerFuture */
+enum class TimerFutureStatus {
+    Pending,  /* Neither completed nor timed out yet */
+    Ready,    /* Completed, or the delay of after() elapsed */
+    TimedOut  /* The timeout of withTimeout() elapsed first */
+};
+
+/* Shared state ---------------------------------------- */
+/** @brief State shared by a TimerFuture, its TimerPromise and
+ * its timer, allocated once. The timer's cancel flag lives in
+ * it too, so cancelling the timer is a single atomic store
+ */
+template<typename T>
+class TimerFutureState
+{
+    public:
+        // void futures store an empty value
+        struct Empty {};
+        using value_type = typename std::conditional<std::is_void<T>::value, Empty, T>::type;
+
+        using continuation_type = std::function<void(TimerFutureStatus)>;
+
+        explicit TimerFutureState();
+
+        /** @brief Complete once, returns false if it was already complete */
+        bool complete(TimerFutureStatus status, std::optional<value_type> value = std::nullopt);
+
+        /** @brief Call the continuation once complete, right away if
+         * it is already. Returns false in that case if `inlineCall`
+         * is false, without calling it
+         */
+        bool then(continuation_type continuation, bool inlineCall = true);
+
+        TimerFutureStatus status() const;
+        TimerFutureStatus wait() const;
+
+        template<typename Rep, typename Period>
+        TimerFutureStatus wait_for(std::chrono::duration<Rep, Period> const &timeout) const;
+
+        std::optional<value_type> &value();
+
+        // Cancel flag of the timer, set once complete
+        std::atomic<bool> timerCancelled;
+
+    private:
+        using Lock       = std::mutex;
+        using ScopedLock = std::unique_lock<Lock>;
+
+        mutable Lock                    sync;
+        mutable std::condition_variable completed;
+
+        TimerFutureStatus         state;
+        std::optional<value_type> result;
+        continuation_type         continuation;
+};
+
+/* TimerFuture class definition ------------------------ */
+/** @brief Lightweight future of a timer, see after() and withTimeout()
+ * get() returns an empty optional (or false for void futures)
+ * if the future timed out. With C++20 coroutines, a TimerFuture
+ * can be co_awaited: the coroutine resumes on the thread that
+ * completes it, typically the TimerThread's worker
+ */
+template<typename T>
+class TimerFuture
+{
+    public:
+        using state_type  = TimerFutureState<T>;
+        using value_type  = typename state_type::value_type;
+        using result_type = typename std::conditional<std::is_void<T>::value, bool, std::optional<value_type>>::type;
+
+        explicit TimerFuture(std::shared_ptr<state_type> state);
+
+        /* Peek at current state */
+        TimerFutureStatus status() const;
+        bool              ready() const;
+
+        /** @brief Block until completion or timeout */
+        TimerFutureStatus wait() const;
+
+        template<typename Rep, typename Period>
+        TimerFutureStatus wait_for(std::chrono::duration<Rep, Period> const &timeout) const;
+
+        /** @brief Block until completion or timeout, and get the value */
+        result_type get();
+
+        /** @brief Call `continuation` with the status once complete
+         * It runs on the completing thread, or right away if complete
+         */
+        void then(std::function<void(TimerFutureStatus)> continuation);
+
+#if defined(TIMER_FUTURE_COROUTINES)
+        /* Awaitable interface */
+        bool        await_ready() const;
+        bool        await_suspend(std::coroutine_handle<> handle);
+        result_type await_resume();
+#endif /* TIMER_FUTURE_COROUTINES */
+
+    private:
+        result_type result();
+
+        std::shared_ptr<state_type> state;
+};
+
+/* TimerPromise class definition ----------------------- */
+/** @brief Completes the TimerFuture of withTimeout() */
+template<typename T>
+class TimerPromise
+{
+    public:
+        using state_type = TimerFutureState<T>;
+        using value_type = typename state_type::value_type;
+
+        explicit TimerPromise(std::shared_ptr<state_type> state);
+
+        /** @brief Complete the future, and cancel its timeout
+         * Returns false if the future already timed out
+         */
+        template<typename ... Args>
+        bool set_value(Args && ... args);
+
+        /** @brief Whether the future timed out, so that the
+         * operation can be abandoned
+         */
+        bool timedOut() const;
+
+    private:
+        std::shared_ptr<state_type> state;
+};
+
+/* Factories ------------------------------------------- */
+/** @brief Future that becomes ready `delay` microseconds from now */
+TimerFuture<void> after(TimerThread::time_us_t delay,
+                        TimerThread           &timerThread = TimerThread::global());
+
+/** @brief Run an operation with a timeout
+ * `op` is called right away with a TimerPromise<T>, which it
+ * completes when the operation does, from any thread. The
+ * returned future is ready with the value if it does within
+ * `timeout` microseconds, and times out otherwise. When the
+ * operation completes first, its timer is cancelled without
+ * locking the TimerThread
+ */
+template<typename T, typename Operation>
+TimerFuture<T> withTimeout(Operation            &&op,
+                            TimerThread::time_us_t timeout,
+                            TimerThread           &timerThread = TimerThread::global());
+
+/* Template implementation of class methods */
+template<typename T>
+TimerFutureState<T>::TimerFutureState()
+    : timerCancelled(false),
+    state(TimerFutureStatus::Pending)
+{
+}
+
+template<typename T>
+bool TimerFutureState<T>::complete(TimerFutureStatus status, std::optional<value_type> value)
+{
+    ScopedLock lock(sync);
+
+    if (TimerFutureStatus::Pending != state) {
+        return false;
+    }
+
+    state  = status;
+    result = std::move(value);
+
+    // The timer has nothing left to do
+    timerCancelled.store(true, std::memory_order_release);
+
+    continuation_type next = std::move(continuation);
+
+    lock.unlock();
+    completed.notify_all();
+
+    if (next) {
+        next(status);
+    }
+
+    return true;
+}
+
+template<typename T>
+bool TimerFutureState<T>::then(continuation_type next, bool inlineCall)
+{
+    ScopedLock lock(sync);
+
+    if (TimerFutureStatus::Pending == state) {
+        continuation = std::move(next);
+        return true;
+    }
+
+    TimerFutureStatus const status = state;
+
+    lock.unlock();
+
+    if (!inlineCall) {
+        return false;
+    }
+
+    next(status);
+
+    return true;
+}
+
+template<typename T>
+TimerFutureStatus TimerFutureState<T>::status() const
+{
+    ScopedLock lock(sync);
+
+    return state;
+}
+
+template<typename T>
+TimerFutureStatus TimerFutureState<T>::wait() const
+{
+    ScopedLock lock(sync);
+
+    completed.wait(lock, [this] {
+        return TimerFutureStatus::Pending != state;
+    });
+
+    return state;
+}
+
+template<typename T>
+template<typename Rep, typename Period>
+TimerFutureStatus TimerFutureState<T>::wait_for(std::chrono::duration<Rep, Period> const &timeout) const
+{
+    ScopedLock lock(sync);
+
+    completed.wait_for(lock, timeout, [this] {
+        return TimerFutureStatus::Pending != state;
+    });
+
+    return state;
+}
+
+// NOTE: only read once complete, it is not written anymore
+template<typename T>
+std::optional<typename TimerFutureState<T>::value_type> &TimerFutureState<T>::value()
+{
+    return result;
+}
+
+template<typename T>
+TimerFuture<T>::TimerFuture(std::shared_ptr<state_type> state)
+    : state(std::move(state))
+{
+}
+
+template<typename T>
+TimerFutureStatus TimerFuture<T>::status() const
+{
+    return state->status();
+}
+
+template<typename T>
+bool TimerFuture<T>::ready() const
+{
+    return TimerFutureStatus::Ready == state->status();
+}
+
+template<typename T>
+TimerFutureStatus TimerFuture<T>::wait() const
+{
+    return state->wait();
+}
+
+template<typename T>
+template<typename Rep, typename Period>
+TimerFutureStatus TimerFuture<T>::wait_for(std::chrono::duration<Rep, Period> const &timeout) const
+{
+    return state->wait_for(timeout);
+}
+
+template<typename T>
+typename TimerFuture<T>::result_type TimerFuture<T>::get()
+{
+    state->wait();
+
+    return result();
+}
+
+template<typename T>
+void TimerFuture<T>::then(std::function<void(TimerFutureStatus)> continuation)
+{
+    state->then(std::move(continuation));
+}
+
+#if defined(TIMER_FUTURE_COROUTINES)
+template<typename T>
+bool TimerFuture<T>::await_ready() const
+{
+    return TimerFutureStatus::Pending != state->status();
+}
+
+template<typename T>
+bool TimerFuture<T>::await_suspend(std::coroutine_handle<> handle)
+{
+    // Resume right away if it completed meanwhile
+    return state->then([handle](TimerFutureStatus) {
+                            handle.resume();
+                        },
+                        false);
+}
+
+template<typename T>
+typename TimerFuture<T>::result_type TimerFuture<T>::await_resume()
+{
+    return result();
+}
+#endif /* TIMER_FUTURE_COROUTINES */
+
+// NOTE: called once complete
+template<typename T>
+typename TimerFuture<T>::result_type TimerFuture<T>::result()
+{
+    if constexpr (std::is_void<T>::value) {
+        return TimerFutureStatus::Ready == state->status();
+    } else {
+        return std::move(state->value());
+    }
+}
+
+template<typename T>
+TimerPromise<T>::TimerPromise(std::shared_ptr<state_type> state)
+    : state(std::move(state))
+{
+}
+
+template<typename T>
+template<typename ... Args>
+bool TimerPromise<T>::set_value(Args && ... args)
+{
+    return state->complete(TimerFutureStatus::Ready, value_type(std::forward<Args>(args) ...));
+}
+
+template<typename T>
+bool TimerPromise<T>::timedOut() const
+{
+    return TimerFutureStatus::TimedOut == state->status();
+}
+
+inline TimerFuture<void> after(TimerThread::time_us_t delay, TimerThread &timerThread)
+{
+    auto state = std::make_shared<TimerFutureState<void>>();
+
+    timerThread.addCancellableTimer(delay,
+                                    0,
+                                    [state]() {
+                                        state->complete(TimerFutureStatus::Ready);
+                                    },
+                                    std::shared_ptr<std::atomic<bool> const>(state, &(state->timerCancelled)));
+
+    return TimerFuture<void>(state);
+}
+
+template<typename T, typename Operation>
+TimerFuture<T> withTimeout(Operation &&op, TimerThread::time_us_t timeout, TimerThread &timerThread)
+{
+    auto state = std::make_shared<TimerFutureState<T>>();
+
+    // Armed first, the operation may complete right away
+    timerThread.addCancellableTimer(timeout,
+                                    0,
+                                    [state]() {
+                                        state->complete(TimerFutureStatus::TimedOut);
+                                    },
+                                    std::shared_ptr<std::atomic<bool> const>(state, &(state->timerCancelled)));
+
+    std::forward<Operation>(op)(TimerPromise<T>(state));
+
+    return TimerFuture<T>(state);
+}
+
+#endif /* TIMERFUTURE_HXX */
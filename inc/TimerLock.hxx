@@ -0,0 +1,177 @@
+/**
+ * TimerLock and TimerCondition class definitions
+ *
+ * @file TimerLock.hxx
+ */
+
+#ifndef TIMERLOCK_HXX
+#define TIMERLOCK_HXX
+
+/* Includes -------------------------------------------- */
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <cstdint>
+
+#include <pthread.h>
+#include <time.h>
+
+/* Defines --------------------------------------------- */
+#ifndef TIMER_LOCK_MAX_SPINS
+#define TIMER_LOCK_MAX_SPINS 100 /* Upper bound of the adaptive spin, in attempts */
+#endif /* TIMER_LOCK_MAX_SPINS */
+
+/* TimerLock class definition -------------------------- */
+/** @brief Mutex protecting a TimerThread, with a selectable policy
+ *
+ * The critical sections of a TimerThread are short, so parking
+ * a contending thread in the kernel right away can cost more
+ * than the section itself.
+ *
+ * - Blocking : plain futex-based mutex, like std::mutex
+ * - AdaptiveSpin : spins for a bounded number of attempts before
+ *   sleeping on the futex. The bound adapts to the number of
+ *   attempts that were needed recently, up to TIMER_LOCK_MAX_SPINS.
+ *   It spins on a relaxed load of whether the mutex is held, and
+ *   only tries to take it when it looks free
+ * - PriorityInheritance : the owner inherits the priority of the
+ *   highest priority waiter, for real-time users
+ *
+ * It meets the Lockable requirements, so it can be used with
+ * std::unique_lock, and with TimerCondition.
+ */
+class TimerLock
+{
+    public:
+        /** @brief Locking policies */
+        enum class Policy {
+            Blocking,
+            AdaptiveSpin,
+            PriorityInheritance
+        };
+
+        explicit TimerLock(Policy policy = Policy::Blocking);
+        ~TimerLock();
+
+        // Never called
+        TimerLock(TimerLock const &r)            = delete;
+        TimerLock &operator=(TimerLock const &r) = delete;
+
+        void lock();
+        bool try_lock() noexcept;
+        void unlock() noexcept;
+
+        Policy           policy() const noexcept;
+        pthread_mutex_t *native_handle() noexcept;
+
+    private:
+        friend class TimerCondition;
+
+        pthread_mutex_t mutex;
+        Policy const    lockPolicy;
+
+        // Whether the mutex is held, a hint for the adaptive spin.
+        // Cleared by TimerCondition while it waits
+        std::atomic<bool> held;
+
+        // Moving average of the attempts needed
+        // by the recent adaptive spins
+        std::atomic<int> spins;
+};
+
+/* TimerSpinLock class definition ---------------------- */
+/** @brief One-byte spin lock, for the many tiny critical
+ * sections of the concurrent queue backends
+ *
+ * It spins on a relaxed load, and yields the CPU every
+ * TIMER_LOCK_MAX_SPINS attempts, so a preempted owner can run.
+ * It meets the Lockable requirements.
+ */
+class TimerSpinLock
+{
+    public:
+        explicit TimerSpinLock() noexcept;
+
+        // Never called
+        TimerSpinLock(TimerSpinLock const &r)            = delete;
+        TimerSpinLock &operator=(TimerSpinLock const &r) = delete;
+
+        void lock() noexcept;
+        bool try_lock() noexcept;
+        void unlock() noexcept;
+
+    private:
+        std::atomic<bool> locked;
+};
+
+/* TimerCondition class definition --------------------- */
+/** @brief Condition variable working with a TimerLock
+ *
+ * Waits with a deadline are measured on CLOCK_MONOTONIC, so
+ * they are not affected by changes of the system time.
+ */
+class TimerCondition
+{
+    public:
+        using ScopedLock = std::unique_lock<TimerLock>;
+
+        explicit TimerCondition();
+        ~TimerCondition();
+
+        // Never called
+        TimerCondition(TimerCondition const &r)            = delete;
+        TimerCondition &operator=(TimerCondition const &r) = delete;
+
+        void wait(ScopedLock &lock);
+
+        template<typename Predicate>
+        void wait(ScopedLock &lock, Predicate pred);
+
+        template<typename Clock, typename Duration>
+        std::cv_status wait_until(ScopedLock                                    &lock,
+                                    std::chrono::time_point<Clock, Duration> const &deadline);
+
+        void notify_one() noexcept;
+        void notify_all() noexcept;
+
+    private:
+        std::cv_status wait_until_monotonic(ScopedLock &lock, timespec const &deadline);
+
+        pthread_cond_t cond;
+};
+
+/* Template implementation of class methods */
+template<typename Predicate>
+void TimerCondition::wait(ScopedLock &lock, Predicate pred)
+{
+    while (!pred()) {
+        wait(lock);
+    }
+}
+
+template<typename Clock, typename Duration>
+std::cv_status TimerCondition::wait_until(ScopedLock                                    &lock,
+                                            std::chrono::time_point<Clock, Duration> const &deadline)
+{
+    // Translate the deadline into CLOCK_MONOTONIC time
+    std::int64_t const remaining
+        = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now()).count();
+
+    if (0 >= remaining) {
+        return std::cv_status::timeout;
+    }
+
+    timespec lDeadline;
+    clock_gettime(CLOCK_MONOTONIC, &lDeadline);
+
+    std::int64_t const nsec = static_cast<std::int64_t>(lDeadline.tv_nsec) + (remaining % 1000000000);
+
+    lDeadline.tv_sec  += static_cast<time_t>((remaining / 1000000000) + (nsec / 1000000000));
+    lDeadline.tv_nsec  = static_cast<long>(nsec % 1000000000);
+
+    return wait_until_monotonic(lock, lDeadline);
+}
+
+#endif /* TIMERLOCK_HXX */
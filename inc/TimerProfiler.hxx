@@ -0,0 +1,111 @@
+/**
+ * TimerProfiler class definition
+ *
+ * @file TimerProfiler.hxx
+ */
+
+#ifndef TIMERPROFILER_HXX
+#define TIMERPROFILER_HXX
+
+/* Includes -------------------------------------------- */
+#include <array>
+#include <string>
+
+#include <cstdint>
+#include <cstddef>
+
+/* TimerProfiler class definition ---------------------- */
+/** @brief Workload profile of a TimerThread
+ *
+ * Records the shape of the timers a TimerThread handles:
+ * histograms of the requested delays and of the timers'
+ * lifetimes (split between timers that fired and timers that
+ * were cancelled), the cancel ratio and how often keyed timers
+ * are reset.
+ *
+ * The histograms have power of two buckets: bucket `b` counts
+ * the values `v` (in microseconds) such that 2^(b-1) <= v < 2^b,
+ * bucket 0 counts the zero values.
+ *
+ * report() turns the profile into a recommendation of queue
+ * backend, tick resolution and timing wheel geometry.
+ *
+ * A TimerProfiler is not thread safe, the TimerThread records
+ * into it with its lock held and hands out copies.
+ */
+class TimerProfiler
+{
+    public:
+        /* Defining the microsecond type */
+        using time_us_t = std::int64_t;
+
+        /* Defining the histogram type */
+        static std::size_t constexpr buckets = 64U;
+        using Histogram = std::array<std::uint64_t, buckets>;
+
+        explicit TimerProfiler();
+
+        /* Recording, called by the TimerThread */
+        void created(time_us_t delay, time_us_t period, std::size_t pending) noexcept;
+        void fired(time_us_t lifetime) noexcept;
+        void periodicFired() noexcept;
+        void cancelled(time_us_t lifetime) noexcept;
+        void reset() noexcept;
+
+        /* Histograms */
+        Histogram const &delays() const noexcept;
+        Histogram const &firedLifetimes() const noexcept;
+        Histogram const &cancelledLifetimes() const noexcept;
+
+        /* Counters */
+        std::uint64_t creations() const noexcept;
+        std::uint64_t periodics() const noexcept;
+        std::uint64_t fires() const noexcept;
+        std::uint64_t periodicFires() const noexcept;
+        std::uint64_t cancels() const noexcept;
+        std::uint64_t resets() const noexcept;
+        std::size_t   peakPending() const noexcept;
+
+        /** @brief Share of the finished timers that were cancelled
+         * rather than fired, between 0 and 1
+         */
+        double cancelRatio() const noexcept;
+
+        /** @brief Share of the timer creations that were keyed
+         * timer resets, between 0 and 1
+         */
+        double resetRatio() const noexcept;
+
+        /** @brief Upper bound of the bucket holding the given
+         * quantile (between 0 and 1) of a histogram
+         */
+        static time_us_t quantile(Histogram const &histogram, double q) noexcept;
+
+        /** @brief Human readable profile and recommendations */
+        std::string report() const;
+
+        /* Recommendations, also part of report() */
+        const char *recommendedBackend() const noexcept;
+        time_us_t   recommendedResolution() const noexcept;
+        std::size_t recommendedWheelLevels() const noexcept;
+
+        /* Slots per level of the recommended timing wheel */
+        static std::size_t constexpr wheelSlots = 256U;
+
+    private:
+        static std::size_t bucket(time_us_t value) noexcept;
+
+        Histogram delayHistogram;
+        Histogram firedHistogram;
+        Histogram cancelledHistogram;
+
+        std::uint64_t creationCount;
+        std::uint64_t periodicCount;
+        std::uint64_t fireCount;
+        std::uint64_t periodicFireCount;
+        std::uint64_t cancelCount;
+        std::uint64_t resetCount;
+        std::size_t   pendingPeak;
+};
+
+#endif /* TIMERPROFILER_HXX */
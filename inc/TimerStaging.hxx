@@ -0,0 +1,390 @@
+/**
+ * TimerStaging class definition
+ *
+ * @file TimerStaging.hxx
+ */
+
+#ifndef TIMERSTAGING_HXX
+#define TIMERSTAGING_HXX
+
+/* Includes -------------------------------------------- */
+#include "ConcurrentWheel.hxx"
+#include "ConcurrentSkipList.hxx"
+#include "MultiQueue.hxx"
+#include "ProducerHeaps.hxx"
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include <cstdint>
+#include <cstddef>
+
+/* TimerStaging class definition ----------------------- */
+/** @brief Staging backends, where producers leave entries without
+ * the lock of their consumer
+ *
+ * Each backend is allocated the first time it is selected, and kept
+ * until the TimerStaging is destroyed, so that the entries already
+ * in it are still collected once another one is selected. New
+ * entries only go to the selected one.
+ *
+ * Any thread may insert() and take() entries. The other methods are
+ * called with the lock of the consumer held, which collect() and
+ * claim() expect to be the only thread to pop the backends.
+ *
+ * The entries of the LocalHeaps backend left by other producers
+ * can't be taken by a thread, only claimed by the consumer. Such a
+ * thread posts the ID with post(), and waits under the consumer's
+ * lock until round() changed. The consumer serves the posted IDs
+ * with serve(), before it sleeps.
+ *
+ * T must be default constructible, movable, and have an `id`
+ * (unique) and a `next` (std::chrono::time_point) member.
+ */
+template<typename T>
+class TimerStaging
+{
+    public:
+        using id_type   = decltype(T::id);
+        using Timestamp = decltype(T::next);
+        using Duration  = std::chrono::microseconds;
+
+        /** @brief Backends, see TimerThread::QueueBackend */
+        enum class Backend : unsigned {
+            None,
+            ConcurrentWheel,
+            SkipList,
+            MultiQueue,
+            LocalHeaps
+        };
+
+        /** @brief Constructor, the ConcurrentWheel backend gets
+         * `wheelSlots` buckets of `wheelResolution`
+         */
+        explicit TimerStaging(std::size_t wheelSlots, Duration wheelResolution);
+
+        // Never called
+        TimerStaging(TimerStaging const &r)            = delete;
+        TimerStaging &operator=(TimerStaging const &r) = delete;
+
+        /** @brief Select the backend new entries go to, None to stop
+         * staging them. The MultiQueue pops the earliest of `choices`
+         * heads, see MultiQueue::pop
+         */
+        void select(Backend backend);
+        void setRelaxation(std::size_t choices) noexcept;
+
+        /** @brief Whether a backend was ever selected, from any thread */
+        bool used() const noexcept;
+
+        /** @brief Whether new entries are staged, from any thread */
+        bool accepts() const noexcept;
+
+        /** @brief Insert an entry into the selected backend, from any
+         * thread. `collected` is set to when the consumer collects it
+         *
+         * @return false if it is due too soon, or nothing is selected.
+         * The entry is left untouched
+         */
+        bool insert(T &entry, Timestamp &collected);
+
+        /** @brief Take an entry out of the backends, from any thread
+         *
+         * @return false if it is in none of them, or it can only be
+         * claimed
+         */
+        bool take(id_type id, T &entry);
+
+        /** @brief Whether an entry can only be claimed by the consumer */
+        bool claimable(id_type id) const;
+
+        /** @brief Claim an entry, consumer only
+         *
+         * @return false if it is not there anymore
+         */
+        bool claim(id_type id, T &entry);
+
+        /** @brief Post the ID of an entry for the consumer to claim */
+        void post(id_type id);
+
+        /** @brief Whether IDs are posted and not served yet */
+        bool posted() const noexcept;
+
+        /** @brief Rounds of posted IDs served so far */
+        std::uint64_t round() const noexcept;
+
+        /** @brief Claim the posted IDs, consumer only. `fn`
+         * is called with each entry that was still there
+         */
+        template<typename F>
+        void serve(F fn);
+
+        /** @brief Pop the entries due at `now`, consumer only. `fn`
+         * is called with each of them. `lock` is the consumer's lock,
+         * released while collecting the buckets of the ConcurrentWheel
+         */
+        template<typename L, typename F>
+        void collect(L &lock, Timestamp now, F fn);
+
+        /** @brief When the next entry must be collected, consumer only.
+         * Timestamp::max() if there are none
+         */
+        Timestamp next();
+
+        /** @brief Drop all the entries */
+        void clear();
+
+        /* Peek at current state */
+        std::size_t size() const;
+
+    private:
+#ifdef TEST
+        friend class TimerThreadTest;
+#endif /* TEST */
+
+        static unsigned bit(Backend backend) noexcept
+        {
+            return 1U << static_cast<unsigned>(backend);
+        }
+
+        std::size_t const wheelSlots;
+        Duration const    wheelResolution;
+
+        std::unique_ptr<ConcurrentWheel<T>>    wheel;
+        std::unique_ptr<ConcurrentSkipList<T>> list;
+        std::unique_ptr<MultiQueue<T>>         queue;
+        std::unique_ptr<ProducerHeaps<T>>      heaps;
+        std::size_t                            relaxation;
+
+        // Bits of the backends allocated, which can be used without
+        // the lock once set, and the one new entries go to
+        std::atomic<unsigned> backends;
+        std::atomic<Backend>  selected;
+
+        // IDs posted for the consumer to claim
+        std::vector<id_type> claims;
+        std::uint64_t        rounds;
+};
+
+/* Template implementation of class methods */
+template<typename T>
+TimerStaging<T>::TimerStaging(std::size_t wheelSlots, Duration wheelResolution)
+    : wheelSlots(wheelSlots),
+    wheelResolution(wheelResolution),
+    wheel(),
+    list(),
+    queue(),
+    heaps(),
+    relaxation(TIMER_MULTIQUEUE_CHOICES),
+    backends(0U),
+    selected(Backend::None),
+    claims(),
+    rounds(0U)
+{
+}
+
+template<typename T>
+void TimerStaging<T>::select(Backend backend)
+{
+    if ((Backend::ConcurrentWheel == backend) && !wheel) {
+        wheel.reset(new ConcurrentWheel<T>(wheelSlots, wheelResolution));
+    } else if ((Backend::SkipList == backend) && !list) {
+        list.reset(new ConcurrentSkipList<T>);
+    } else if ((Backend::MultiQueue == backend) && !queue) {
+        std::size_t const threads = std::max(std::thread::hardware_concurrency(), 1U);
+
+        queue.reset(new MultiQueue<T>(TIMER_MULTIQUEUE_FACTOR * threads));
+    } else if ((Backend::LocalHeaps == backend) && !heaps) {
+        heaps.reset(new ProducerHeaps<T>);
+    }
+
+    if (Backend::None != backend) {
+        backends.fetch_or(bit(backend), std::memory_order_release);
+    }
+
+    selected.store(backend, std::memory_order_release);
+}
+
+template<typename T>
+void TimerStaging<T>::setRelaxation(std::size_t choices) noexcept
+{
+    relaxation = std::max<std::size_t>(choices, 1U);
+}
+
+template<typename T>
+bool TimerStaging<T>::used() const noexcept
+{
+    return 0U != backends.load(std::memory_order_acquire);
+}
+
+template<typename T>
+bool TimerStaging<T>::accepts() const noexcept
+{
+    return Backend::None != selected.load(std::memory_order_acquire);
+}
+
+template<typename T>
+bool TimerStaging<T>::insert(T &entry, Timestamp &collected)
+{
+    collected = entry.next;
+
+    switch (selected.load(std::memory_order_acquire)) {
+        case Backend::ConcurrentWheel:
+            collected = wheel->collectedAt(entry.next);
+            return wheel->insert(entry);
+        case Backend::SkipList:
+            list->insert(std::move(entry));
+            return true;
+        case Backend::MultiQueue:
+            queue->insert(std::move(entry));
+            return true;
+        case Backend::LocalHeaps:
+            return heaps->insert(entry);
+        default:
+            return false;
+    }
+}
+
+template<typename T>
+bool TimerStaging<T>::take(id_type id, T &entry)
+{
+    unsigned const lBackends = backends.load(std::memory_order_acquire);
+
+    return ((0U != (lBackends & bit(Backend::ConcurrentWheel))) && wheel->take(id, entry))
+           || ((0U != (lBackends & bit(Backend::SkipList))) && list->take(id, entry))
+           || ((0U != (lBackends & bit(Backend::MultiQueue))) && queue->take(id, entry))
+           || ((0U != (lBackends & bit(Backend::LocalHeaps))) && heaps->take(id, entry));
+}
+
+template<typename T>
+bool TimerStaging<T>::claimable(id_type id) const
+{
+    return (0U != (backends.load(std::memory_order_acquire) & bit(Backend::LocalHeaps))) && heaps->contains(id);
+}
+
+template<typename T>
+bool TimerStaging<T>::claim(id_type id, T &entry)
+{
+    return heaps && heaps->claim(id, entry);
+}
+
+template<typename T>
+void TimerStaging<T>::post(id_type id)
+{
+    claims.push_back(id);
+}
+
+template<typename T>
+bool TimerStaging<T>::posted() const noexcept
+{
+    return !claims.empty();
+}
+
+template<typename T>
+std::uint64_t TimerStaging<T>::round() const noexcept
+{
+    return rounds;
+}
+
+template<typename T>
+template<typename F>
+void TimerStaging<T>::serve(F fn)
+{
+    for (id_type const &id : claims) {
+        T entry;
+
+        if (claim(id, entry)) {
+            fn(std::move(entry));
+        }
+    }
+
+    claims.clear();
+    ++rounds;
+}
+
+template<typename T>
+template<typename L, typename F>
+void TimerStaging<T>::collect(L &lock, Timestamp now, F fn)
+{
+    if (wheel) {
+        if (wheel->due(now)) {
+            lock.unlock();
+            wheel->collect(now);
+            lock.lock();
+        }
+
+        wheel->claim(fn);
+    }
+
+    if (list) {
+        list->pop(now, fn);
+        list->reclaim();
+    }
+
+    if (queue) {
+        queue->pop(now, relaxation, fn);
+    }
+
+    if (heaps) {
+        heaps->pop(now, fn);
+    }
+}
+
+template<typename T>
+typename TimerStaging<T>::Timestamp TimerStaging<T>::next()
+{
+    Timestamp lNext = Timestamp::max();
+
+    if (wheel) {
+        lNext = std::min(lNext, wheel->next());
+    }
+
+    if (list) {
+        lNext = std::min(lNext, list->next());
+    }
+
+    if (queue) {
+        lNext = std::min(lNext, queue->next());
+    }
+
+    if (heaps) {
+        lNext = std::min(lNext, heaps->next());
+    }
+
+    return lNext;
+}
+
+template<typename T>
+void TimerStaging<T>::clear()
+{
+    if (wheel) {
+        wheel->clear();
+    }
+
+    if (list) {
+        list->clear();
+    }
+
+    if (queue) {
+        queue->clear();
+    }
+
+    if (heaps) {
+        heaps->clear();
+    }
+}
+
+template<typename T>
+std::size_t TimerStaging<T>::size() const
+{
+    return (wheel ? wheel->size() : 0U)
+           + (list ? list->size() : 0U)
+           + (queue ? queue->size() : 0U)
+           + (heaps ? heaps->size() : 0U);
+}
+
+#endif /* TIMERSTAGING_HXX */
@@ -0,0 +1,139 @@
+/**
+ * TimerStatsWriter and TimerStatsReader class definitions
+ *
+ * @file TimerStats.hxx
+ */
+
+#ifndef TIMERSTATS_HXX
+#define TIMERSTATS_HXX
+
+/* Includes -------------------------------------------- */
+#include <atomic>
+
+#include <cstdint>
+#include <cstddef>
+
+/* Defines --------------------------------------------- */
+#define TIMER_STATS_MAGIC      0x54494d4552535441ULL /* "TIMERSTA" */
+#define TIMER_STATS_VERSION    1U                    /* Bumped on any layout change */
+#define TIMER_STATS_BUCKETS    64U                   /* Buckets of the histograms, see TimerProfiler */
+#define TIMER_STATS_LABELS     32U                   /* Labels published, the others are left out */
+#define TIMER_STATS_LABEL_SIZE 32U                   /* Bytes of a published label, with the terminating NUL */
+
+/* Stats page layout ----------------------------------- */
+/** @brief Statistics of a label, see TimerThread::setLabel */
+struct TimerStatsLabel {
+    char          name[TIMER_STATS_LABEL_SIZE];
+    std::uint64_t fires;
+    std::uint64_t nanoseconds;
+};
+
+/** @brief Statistics published by a TimerThread
+ * Plain data, copied in and out of the stats page as a whole
+ */
+struct TimerStatsData {
+    std::uint64_t pid;            /* Publishing process */
+    std::uint64_t updated;        /* Last update, in microseconds since the epoch */
+    std::uint64_t updates;        /* Number of updates */
+
+    std::uint64_t pending;        /* Pending timers */
+    std::uint64_t created;        /* Timers created */
+    std::uint64_t fired;          /* One-shot timers fired */
+    std::uint64_t periodicFired;  /* Periodic timer releases */
+    std::uint64_t cancelled;      /* Timers cancelled */
+    std::uint64_t deadlineMisses; /* Deadline misses of the periodic timers */
+    std::uint64_t backend;        /* Queue backend, see TimerThread::QueueBackend */
+    std::uint64_t wheelPending;   /* Pending timers in the timing wheel */
+
+    // Histograms of the profiler, zero unless profiling is set
+    std::uint64_t profiling;
+    std::uint64_t delays[TIMER_STATS_BUCKETS];
+    std::uint64_t firedLifetimes[TIMER_STATS_BUCKETS];
+    std::uint64_t cancelledLifetimes[TIMER_STATS_BUCKETS];
+
+    std::uint64_t   labelCount;
+    TimerStatsLabel labels[TIMER_STATS_LABELS];
+};
+
+/** @brief Layout of the memory-mapped stats file
+ *
+ * The data is protected by a sequence lock: the writer makes
+ * `sequence` odd while it updates the data, and even again once
+ * done. A reader copies the data out, and retries if `sequence`
+ * was odd or changed meanwhile. Neither side makes a system call.
+ */
+struct TimerStatsPage {
+    std::uint64_t              magic;   /* TIMER_STATS_MAGIC */
+    std::uint32_t              version; /* TIMER_STATS_VERSION */
+    std::uint32_t              size;    /* sizeof(TimerStatsPage) */
+    std::atomic<std::uint64_t> sequence;
+    TimerStatsData             data;
+};
+
+/* TimerStatsWriter class definition ------------------- */
+/** @brief Publishes TimerStatsData to a memory-mapped file
+ * Only one thread may write at a time
+ */
+class TimerStatsWriter
+{
+    public:
+        explicit TimerStatsWriter();
+
+        /** @brief Destructor unmaps the file, which is left in place */
+        ~TimerStatsWriter();
+
+        // Never called
+        TimerStatsWriter(TimerStatsWriter const &r)            = delete;
+        TimerStatsWriter &operator=(TimerStatsWriter const &r) = delete;
+
+        /** @brief Create (or truncate) and map the stats file */
+        int open(const char * const pPath);
+
+        /** @brief Unmap the stats file */
+        void close() noexcept;
+
+        /** @brief Publish the data, does not make any system call */
+        void write(TimerStatsData const &pData) noexcept;
+
+        bool isOpen() const noexcept;
+
+    private:
+        TimerStatsPage *page;
+};
+
+/* TimerStatsReader class definition ------------------- */
+/** @brief Reads TimerStatsData from a memory-mapped file
+ * published by another process
+ */
+class TimerStatsReader
+{
+    public:
+        explicit TimerStatsReader();
+
+        /** @brief Destructor unmaps the file */
+        ~TimerStatsReader();
+
+        // Never called
+        TimerStatsReader(TimerStatsReader const &r)            = delete;
+        TimerStatsReader &operator=(TimerStatsReader const &r) = delete;
+
+        /** @brief Map the stats file, read-only
+         * Fails if the file does not have the expected layout version
+         */
+        int open(const char * const pPath);
+
+        /** @brief Unmap the stats file */
+        void close() noexcept;
+
+        /** @brief Copy a consistent snapshot of the data
+         * Does not make any system call
+         */
+        int read(TimerStatsData &pData) const noexcept;
+
+        bool isOpen() const noexcept;
+
+    private:
+        TimerStatsPage const *page;
+};
+
+#endif /* TIMERSTATS_HXX */
@@ -11,13 +11,55 @@
 #include <functional>
 #include <chrono>
 #include <unordered_map>
+#include <unordered_set>
 #include <set>
+#include <vector>
+#include <array>
+#include <utility>
+#include <atomic>
+#if defined(__has_include)
+#if __has_include(<stop_token>)
+#include <stop_token>
+#endif /* __has_include(<stop_token>) */
+#endif /* __has_include */
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <memory>
+#include <string>
+
+#include "TimerLock.hxx"
+#include "TimerStaging.hxx"
+#include "TimerCombiner.hxx"
+#include "TimerProfiler.hxx"
+#include "TimerStats.hxx"
 
 #include <cstdint>
 
+/* Defines --------------------------------------------- */
+#ifndef TIMER_LANES
+#define TIMER_LANES 8 /* Number of FIFO lanes of constant-duration timers, 0 to disable them */
+#endif /* TIMER_LANES */
+
+#ifndef TIMER_WHEEL_SLOTS
+#define TIMER_WHEEL_SLOTS 4096 /* Number of slots of the timing wheel backend */
+#endif /* TIMER_WHEEL_SLOTS */
+
+#ifndef TIMER_WHEEL_RESOLUTION
+#define TIMER_WHEEL_RESOLUTION 1000 /* Width of a slot of the timing wheel backend, in microseconds */
+#endif /* TIMER_WHEEL_RESOLUTION */
+
+#ifndef TIMER_MIGRATION_BATCH
+#define TIMER_MIGRATION_BATCH 64 /* Timers moved between backends per operation */
+#endif /* TIMER_MIGRATION_BATCH */
+
+#ifndef TIMER_BACKEND_WINDOW
+#define TIMER_BACKEND_WINDOW 1024 /* Finished timers per cancel ratio measurement */
+#endif /* TIMER_BACKEND_WINDOW */
+
+/* Forward declarations -------------------------------- */
+class TimerDomain;
+
 /* TimerThread class definition ------------------------ */
 class TimerThread
 {
@@ -35,12 +77,69 @@ class TimerThread
         /* Defining the microsecond type */
         using time_us_t = std::int64_t; /* Values that are a large-range microsecond count */
 
+        /* Defining the deadline miss handler type
+         * Called with the timer's ID and how late (in microseconds)
+         * the handler completed relative to the timer's next release
+         */
+        using miss_handler_type = std::function<void(timer_id_t, time_us_t)>;
+
+        /* Defining the timer key type, chosen by the user to identify keyed timers */
+        using timer_key_t = std::uint64_t;
+
+        /** @brief How upsertTimer resolves a request for a key that already has a timer */
+        enum class UpsertPolicy {
+            KeepEarliest, /* The timer fires at the earliest of the two deadlines */
+            KeepLatest,   /* The timer fires at the latest of the two deadlines */
+            Replace       /* The new request always replaces the existing timer */
+        };
+
+        /* Defining the policy of the lock protecting the TimerThread, see TimerLock */
+        using LockPolicy = TimerLock::Policy;
+
+        /** @brief What a periodic timer does after a deadline miss */
+        enum class MissPolicy {
+            Fire, /* Fire the missed releases back to back to catch up (default) */
+            Shed  /* Drop the missed releases, fire again at the first release after completion */
+        };
+
+        /** @brief Handler statistics of a label, see setLabel */
+        struct LabelStats {
+            std::uint64_t fires;       /* Number of handler calls */
+            std::uint64_t nanoseconds; /* Time spent in the handlers */
+        };
+
+        /** @brief Queue backends holding the pending timers */
+        enum class QueueBackend {
+            Tree,            /* Ordered tree, O(log n) insertion and cancellation (default) */
+            Wheel,           /* Timing wheel in front of the tree, O(1) insertion and cancellation */
+            ConcurrentWheel, /* Timing wheel in front of the tree, updated without the TimerThread's lock */
+            SkipList,        /* Lock-free skip list in front of the tree */
+            MultiQueue,      /* Relaxed MultiQueue in front of the tree, fires roughly in order */
+            LocalHeaps       /* One heap per producer thread in front of the tree */
+        };
+
         /** @brief Constructor does not start worker until there is a Timer */
         explicit TimerThread();
 
+        /** @brief Constructor selecting how contending threads wait
+         * for the TimerThread's lock, see TimerLock
+         */
+        explicit TimerThread(LockPolicy lockPolicy);
+
+        /** @brief Constructor attaching this TimerThread to a TimerDomain
+         * Its timers run on one of the domain's workers, shared with
+         * the other TimerThreads attached to the domain. clear(),
+         * size(), empty() and the destructor only see the timers
+         * created through this TimerThread. The domain must outlive
+         * the TimerThreads attached to it
+         */
+        explicit TimerThread(TimerDomain &domain);
+
         /** @brief Destructor is thread safe, even if a timer
          * callback is running. All callbacks are guaranteed
          * to have returned before this destructor returns
+         * When attached to a TimerDomain, the timers of this
+         * TimerThread are destroyed, the others keep running
          */
         ~TimerThread();
 
@@ -49,11 +148,96 @@ class TimerThread
          * If msPeriod is nonzero, call the callback again every
          * msPeriod microseconds
          * All timer creation functions eventually call this one
+         * When called from one of this TimerThread's handlers, the
+         * timer is kept by the worker without locking, and queued
+         * once the handler returns. Meanwhile, only clearTimer,
+         * setLabel and setMissHandler (which wait for it to be
+         * queued) and calls from the same handler see it
          */
         timer_id_t addTimer(time_us_t    msDelay,
                             time_us_t    msPeriod,
                             handler_type handler);
 
+        /** @brief Create timer cancelled lazily through a flag
+         * Like addTimer, except that once `cancelFlag` is set, the
+         * handler is not called anymore. Setting the flag does not
+         * lock the TimerThread, so it is cheap and can be done from
+         * any context: the worker destroys the timer when it comes
+         * due. Until then, it keeps its memory and still counts in
+         * size() and empty(), so a long delay or period holds them
+         * that long.
+         * A handler already running when the flag is set completes.
+         * The TimerThread keeps a reference to the flag while the
+         * timer exists
+         */
+        timer_id_t addCancellableTimer(time_us_t                               msDelay,
+                                        time_us_t                               msPeriod,
+                                        handler_type                            handler,
+                                        std::shared_ptr<std::atomic<bool> const> cancelFlag);
+
+#if defined(__cpp_lib_jthread)
+        /** @brief Create timer cancelled by a std::stop_token
+         * Like addCancellableTimer, with a flag set by a
+         * std::stop_callback when a stop is requested on `token`.
+         * Returns no_timer if a stop was already requested.
+         * As with the flag, a stopped timer is only destroyed when
+         * it comes due: until then, it keeps its memory and its
+         * stop_callback registration, and still counts in size()
+         */
+        timer_id_t addTimer(time_us_t       msDelay,
+                            time_us_t       msPeriod,
+                            handler_type    handler,
+                            std::stop_token token);
+#endif /* __cpp_lib_jthread */
+
+        /** @brief Create a deferrable timer using microseconds
+         * Like addTimer, except that the worker does not wake up for
+         * this timer before `msSlack` microseconds after it is due.
+         * Until then, the timer fires when the worker is already
+         * awake, typically for a timer that is not deferrable.
+         * Meant for non-critical housekeeping timers, to save
+         * wakeups of a mostly idle TimerThread.
+         * The periodic releases missed while deferred are coalesced,
+         * and are not reported as deadline misses
+         */
+        timer_id_t addDeferrableTimer(time_us_t    msDelay,
+                                        time_us_t    msPeriod,
+                                        time_us_t    msSlack,
+                                        handler_type handler);
+
+        /** @brief Create or update the timer associated with a key
+         * Ensures there is exactly one timer for `key`. If there is
+         * none, a timer is created as with addTimer. Otherwise,
+         * `policy` chooses between the existing deadline and the
+         * requested one. When the request wins, the existing timer
+         * is moved to the new deadline and takes the new period and
+         * handler, keeping its ID. When the existing timer wins, it
+         * is left untouched and `handler` is discarded.
+         *
+         * If the existing timer's handler is running, it is detached
+         * from the key (a periodic one is not rescheduled) and a new
+         * timer is created for the key.
+         *
+         * The key is released when its timer is destroyed.
+         *
+         * @return The ID of the timer associated with `key`
+         */
+        timer_id_t upsertTimer(timer_key_t  key,
+                                time_us_t    msDelay,
+                                time_us_t    msPeriod,
+                                handler_type handler,
+                                UpsertPolicy policy = UpsertPolicy::Replace);
+
+        /** @brief Destroy the timer associated with a key
+         * Behaves like clearTimer
+         */
+        bool clearKey(timer_key_t key);
+
+        /** @brief Get the ID of the timer associated with a key
+         * Returns no_timer if there is none
+         */
+        timer_id_t keyedTimer(timer_key_t key) const noexcept;
+
         /** @brief Create timer using std::chrono delay and period
          * Optionally binds additional arguments to the callback
          */
@@ -127,6 +311,29 @@ class TimerThread
          */
         bool clearTimer(timer_id_t id);
 
+        /** @brief Set up deadline miss detection for a periodic timer
+         *
+         * A deadline miss happens when the handler of a periodic
+         * timer completes after the timer's next release. Each miss
+         * is counted, then handled according to `policy` and
+         * reported to `handler` (if any) from the worker thread.
+         *
+         * @return false if the timer does not exist
+         */
+        bool setMissHandler(timer_id_t        id,
+                            miss_handler_type handler,
+                            MissPolicy        policy = MissPolicy::Fire);
+
+        /** @brief Number of deadline misses of the given timer
+         * Returns 0 if the timer does not exist
+         */
+        std::uint64_t deadlineMisses(timer_id_t id) const noexcept;
+
+        /** @brief Number of deadline misses of all timers
+         * since this TimerThread was created
+         */
+        std::uint64_t deadlineMisses() const noexcept;
+
         /* @brief Destroy all timers, but preserve id uniqueness
          * This carefully makes sure every timer is not
          * executing its callback before destructing it
@@ -134,6 +341,8 @@ class TimerThread
         void clear();
 
         /* @brief Set the TimerThread's priority
+         * When attached to a TimerDomain, this changes the priority
+         * of the worker shared with other TimerThreads
          */
         int setScheduling(const int &pPolicy, const int &pPriority);
 
@@ -141,6 +350,164 @@ class TimerThread
          */
         int scheduling(int * const pPolicy, int * const pPriority) noexcept;
 
+        /** @brief Start or stop profiling the timer workload
+         * The profile records the requested delays, the lifetimes of
+         * the timers until they fire or are cancelled, and the keyed
+         * timer resets, to choose a queue backend and a resolution
+         * (see TimerProfiler). It costs a clock read per timer and
+         * is off by default. Enabling it again keeps the current
+         * profile, disabling it drops the profile.
+         * When attached to a TimerDomain, the profile covers all
+         * the timers of the shared worker
+         */
+        void enableProfiler(bool enable = true);
+
+        /** @brief Copy the current profile
+         *
+         * @return false if the profiler is not enabled
+         */
+        bool profile(TimerProfiler &pProfiler) const;
+
+        /** @brief Human readable profile and recommendations
+         * Returns an empty string if the profiler is not enabled
+         */
+        std::string profileReport() const;
+
+        /** @brief Attach a label to a timer, for profiling
+         * The label must be a string with static storage duration,
+         * only its address is stored and compared. The worker counts
+         * the calls and the time spent in the handlers of each label
+         * (see labelStats), and can name itself after the label
+         * while a handler runs (see setLabelThreadName).
+         * Unlabelled timers cost nothing more.
+         *
+         * @return false if the timer does not exist
+         */
+        bool setLabel(timer_id_t id, const char *label);
+
+        /** @brief Label of the given timer
+         * Returns nullptr if it has none or does not exist
+         */
+        const char *label(timer_id_t id) const noexcept;
+
+        /** @brief Handler statistics of each label, in no particular order
+         * When attached to a TimerDomain, they cover all the timers
+         * of the shared worker
+         */
+        std::vector<std::pair<const char *, LabelStats>> labelStats() const;
+
+        /** @brief Name the worker thread after the label of the
+         * handler it runs, so that perf, top or any tracer showing
+         * thread names attributes the time to the label. Names are
+         * truncated to 15 characters. This costs a few system calls
+         * per labelled handler call, and is off by default
+         */
+        void setLabelThreadName(bool enable = true);
+
+        /** @brief Publish the statistics to a memory-mapped file
+         * Every `msPeriod` microseconds, the worker copies the
+         * counters, the profiler's histograms and the label
+         * statistics into the file at `pPath`, behind a sequence
+         * lock (see TimerStatsPage). External monitors read it with
+         * TimerStatsReader, without any system call on either side.
+         * Publishing again replaces the previous file. The timer
+         * publishing the file does not count in size() and empty(),
+         * and clear() leaves it.
+         * When attached to a TimerDomain, this publishes the
+         * statistics of the shared worker
+         */
+        int publishStats(const char * const pPath, time_us_t msPeriod);
+
+        /** @brief Stop publishing the statistics, the file is left in place */
+        void unpublishStats();
+
+        /** @brief Select the queue backend, and stop switching it
+         * automatically. The Wheel backend keeps the timers that are
+         * due more than TIMER_WHEEL_RESOLUTION microseconds ahead in
+         * a timing wheel, and moves them into the tree as their
+         * deadline approaches. It pays off with many pending timers
+         * that are mostly cancelled before they fire.
+         * With the other backends, the timers sharing one of
+         * TIMER_LANES durations (the delay of a one-shot timer, the
+         * period of a periodic one) are appended to a FIFO lane in
+         * front of the tree, unless their deadline is earlier than
+         * the last one of the lane. The Wheel backend takes these
+         * timers too.
+         * The pending timers are migrated incrementally, at most
+         * TIMER_MIGRATION_BATCH of them per operation.
+         * With the ConcurrentWheel backend, addTimer and clearTimer
+         * keep such timers in a ConcurrentWheel without taking the
+         * lock, so producer threads rarely contend. The worker moves
+         * them into the tree as their deadline approaches, and so do
+         * setLabel and setMissHandler. The SkipList backend does the
+         * same with a lock-free ConcurrentSkipList, which also takes
+         * the timers due within TIMER_WHEEL_RESOLUTION microseconds,
+         * and which the worker pops as they come due. The MultiQueue
+         * backend spreads the timers over TIMER_MULTIQUEUE_FACTOR
+         * heaps per hardware thread, and the worker pops them roughly
+         * in order, see setRelaxation. With the LocalHeaps backend,
+         * each producer thread keeps its timers in its own heap of
+         * a ProducerHeaps, so producers never contend with each
+         * other. clearTimer takes a timer out of the heap of the
+         * calling thread without the lock, and the timers of the
+         * other threads through the worker, so it waits for the
+         * handler that is running, unless the timer is in none of
+         * the heaps. A thread keeps its heap until it exits. Beyond
+         * TIMER_PRODUCER_SLOTS live producer threads, the timers go
+         * through the lock.
+         * These staging backends only apply to the timers created by
+         * addTimer, setTimeout and setInterval outside of the
+         * handlers, and not to TimerThreads attached to a TimerDomain.
+         * The statistics only cover these timers once they are in
+         * the tree.
+         * When attached to a TimerDomain, this selects the backend
+         * of the worker shared with other TimerThreads
+         */
+        void setQueueBackend(QueueBackend backend);
+
+        /** @brief Set how many heaps of the MultiQueue backend the
+         * worker compares to pop the next timer (default
+         * TIMER_MULTIQUEUE_CHOICES). With fewer choices, popping
+         * is cheaper, but the due timers of the heaps that were not
+         * compared are fired later, possibly after timers that are
+         * due after them. Comparing all the heaps fires the timers
+         * in order, like the other backends
+         */
+        void setRelaxation(std::size_t choices);
+
+        /** @brief Apply addTimer and clearTimer by flat combining
+         * Instead of taking the lock, each thread posts its operation
+         * into its own request record. The thread that gets the lock
+         * applies all the posted operations, and hands the results
+         * back through the records, while the others wait for them.
+         * Under heavy contention, the lock changes hands once for
+         * many operations. Only TIMER_COMBINING_SLOTS live threads
+         * get a record, a thread keeps it until it exits. Like the
+         * staging backends, it does
+         * not apply to the handlers. A clearTimer that must wait
+         * for a handler is left to its own thread.
+         * When attached to a TimerDomain, this applies to the worker
+         * shared with other TimerThreads
+         */
+        void setFlatCombining(bool enabled);
+
+        /** @brief Switch the queue backend automatically
+         * The Wheel backend is selected when there are at least
+         * `wheelAbove` pending timers, or at least `treeBelow`
+         * pending timers of which a share above `cancelRatio` is
+         * cancelled rather than fired. The Tree backend is selected
+         * back under `treeBelow` pending timers, or under `wheelAbove`
+         * pending timers once the cancel ratio fell under half of
+         * `cancelRatio`. The cancel ratio is measured over windows
+         * of TIMER_BACKEND_WINDOW finished timers
+         */
+        void setAdaptiveBackend(std::size_t wheelAbove,
+                                std::size_t treeBelow,
+                                double      cancelRatio);
+
+        /** @brief Backend the pending timers are (being migrated) in */
+        QueueBackend queueBackend() const noexcept;
+
         /* Peek at current state */
         std::size_t size() const noexcept;
         bool        empty() const noexcept;
@@ -149,15 +516,73 @@ class TimerThread
         static TimerThread &global();
 
     private:
+        friend class TimerDomain;
+        friend class TimerBatch;
+#ifdef TEST
+        friend class TimerThreadTest;
+#endif /* TEST */
+
+        // Above any ID in use
+        static timer_id_t constexpr max_timer = ~timer_id_t(0);
+
         /* Type definitions */
-        using Lock         = std::mutex;
+        using Lock         = TimerLock;
         using ScopedLock   = std::unique_lock<Lock>;
-        using ConditionVar = std::condition_variable;
+        using PendingLock  = std::unique_lock<TimerSpinLock>;
+        using ConditionVar = TimerCondition;
 
         using Clock     = std::chrono::high_resolution_clock;
         using Timestamp = std::chrono::time_point<Clock>;
         using Duration  = std::chrono::microseconds; /* changed milliseconds to microseconds */
 
+        // Timer buffered by a TimerBatch, with the deadline
+        // computed when it was buffered
+        struct Submission {
+            timer_id_t   id;
+            Timestamp    next;
+            Duration     delay;
+            Duration     period;
+            handler_type handler;
+        };
+
+        using StagedBackend = TimerStaging<Submission>::Backend;
+
+        struct Timer;
+
+        // Operation of a thread for flat combining, see setFlatCombining
+        struct Operation {
+            TimerThread *owner   = nullptr;
+            bool         add     = false;
+            timer_id_t   id      = no_timer; /* Timer to clear, or the one added */
+            Duration     delay   = Duration(0);
+            Duration     period  = Duration(0);
+            handler_type handler;
+            bool         cleared = false;
+        };
+
+        using Combiner = TimerCombiner<Operation>;
+
+        // Comparison functor to sort the timer "queue" by Timer::deadline()
+        struct DeadlineComparator {
+            bool operator()(Timer const &a, Timer const &b) const noexcept
+            {
+                return a.deadline() < b.deadline();
+            }
+        };
+
+        // Comparison functor to sort the deferrable timers by Timer::next
+        struct NextActiveComparator {
+            bool operator()(Timer const &a, Timer const &b) const noexcept
+            {
+                return a.next < b.next;
+            }
+        };
+
+        // Queue is a set of references to Timer objects, sorted by deadline
+        using QueueValue    = std::reference_wrapper<Timer>;
+        using Queue         = std::multiset<QueueValue, DeadlineComparator>;
+        using DeferredQueue = std::multiset<QueueValue, NextActiveComparator>;
+
         /** @brief Timer structure definition */
         struct Timer {
             explicit Timer(timer_id_t id = 0U);
@@ -165,6 +590,7 @@ class TimerThread
             Timer &operator=(Timer &&r) noexcept;
 
             Timer(timer_id_t   id,
+                    TimerThread &owner,
                     Timestamp    next,
                     Duration     period,
                     handler_type handler) noexcept;
@@ -173,37 +599,165 @@ class TimerThread
             Timer(Timer const &r)            = delete;
             Timer &operator=(Timer const &r) = delete;
 
+            /** @brief Time at which the worker must wake up for this Timer */
+            Timestamp deadline() const noexcept
+            {
+                return next + slack;
+            }
+
+            /** @brief Whether the Timer is deferrable */
+            bool deferrable() const noexcept
+            {
+                return slack.count() > 0;
+            }
+
             timer_id_t   id;
+            TimerThread *owner; /* Front-end the Timer was created through */
             Timestamp    next;
             Duration     period;
+            Duration     slack; /* How long a deferrable Timer may wait for a wakeup */
             handler_type handler;
 
+            // Exact position in the ordering queue, if queued there,
+            // so it is removed without a search, in O(1) amortized
+            Queue::iterator queuePos;
+
+            // Position in the deferrable timers, if deferrable and queued
+            DeferredQueue::iterator deferredPos;
+
             // You must be holding the 'sync' lock to assign waitCond
             std::unique_ptr<ConditionVar> waitCond;
 
-            bool running;
-        };
+            // Deadline miss detection, for periodic timers
+            miss_handler_type missHandler;
+            MissPolicy        missPolicy;
+            std::uint64_t     misses;
 
-        // Comparison functor to sort the timer "queue" by Timer::next
-        struct NextActiveComparator {
-            bool operator()(Timer const &a, Timer const &b) const noexcept
-            {
-                return a.next < b.next;
-            }
+            // Key of the Timer, if it was created by upsertTimer
+            timer_key_t key;
+            bool        keyed;
+
+            // Set when upsertTimer replaced the Timer while its
+            // handler was running, the worker destroys it afterwards
+            bool detached;
+
+            // Links of the FIFO lane of the Timer's duration, if the
+            // Timer is in lane `lane` rather than in the ordering queues
+            Timer *lanePrev;
+            Timer *laneNext;
+            int    lane;
+
+            // Requested delay, the duration of the lane of a one-shot Timer
+            Duration delay;
+
+            // Creation time, only set while profiling
+            Timestamp created;
+
+            // Static label, for profiling
+            const char *label;
+
+            // Once set, the Timer is destroyed instead of fired
+            std::shared_ptr<std::atomic<bool> const> cancelFlag;
+
+            // Links of the timing wheel slot, if the Timer is in
+            // the wheel rather than in the ordering queues
+            Timer *wheelPrev;
+            Timer *wheelNext;
+            bool   wheeled;
+
+            bool running;
         };
 
-        // Queue is a set of references to Timer objects, sorted by next
-        using QueueValue = std::reference_wrapper<Timer>;
-        using Queue      = std::multiset<QueueValue, NextActiveComparator>;
         using TimerMap   = std::unordered_map<timer_id_t, Timer>;
+        using KeyMap     = std::unordered_map<timer_key_t, timer_id_t>;
 
         void timerThreadWorker();
+        bool idle_impl() const;
+        void dispatch_impl(ScopedLock &lock, Timer &timer);
+        Timer &create_impl(ScopedLock  &lock,
+                            TimerThread &owner,
+                            Duration     delay,
+                            Duration     period,
+                            Duration     slack,
+                            handler_type handler,
+                            bool        &needNotify);
+        Timer &admit_impl(Timer &&timer, bool &needNotify);
+        timer_id_t pendingAdd_impl(TimerThread &owner,
+                                    Duration     delay,
+                                    Duration     period,
+                                    handler_type handler);
+        void merge_impl();
+        bool pendingHas_impl(timer_id_t id) const;
+        std::size_t pendingSize_impl() const;
+        void pendingClear_impl();
+        Timer &admitSubmission_impl(Submission &&submission, TimerThread &owner, bool &needNotify);
+        bool stage_impl(Submission &submission);
+        void claim_impl(ScopedLock &lock, timer_id_t id);
+        bool combine_impl(Combiner::Record &record);
+        bool apply_impl(ScopedLock &lock, Operation &operation, bool &needNotify);
+        timer_id_t reserve_impl() noexcept;
+        void submit_impl(std::vector<Submission>       &adds,
+                            std::vector<timer_id_t> const &clears);
+        bool enqueue_impl(Timer &timer);
+        void dequeue_impl(Timer &timer);
+        void erase_impl(Timer &timer);
+        TimerMap::iterator find_impl(timer_id_t id) const;
+        TimerMap::iterator findMerged_impl(ScopedLock &lock, timer_id_t id) const;
         bool destroy_impl(ScopedLock        &lock,
                             TimerMap::iterator i,
                             bool               notify);
-
-        // Inexhaustible source of unique IDs
-        timer_id_t nextId;
+        void deadlineMiss(ScopedLock &lock,
+                            Timer      &timer,
+                            Timestamp   completed);
+        void finished_impl(Timer const &timer, bool cancelled);
+
+        /* Queue backends */
+        bool laneInsert_impl(Timer &timer);
+        void laneRemove_impl(Timer &timer);
+        Timer *head_impl();
+        bool wheelInsert_impl(Timer &timer);
+        void wheelRemove_impl(Timer &timer);
+        void wheelAdvance_impl(Timestamp now);
+        Timestamp wheelNext_impl() const;
+        void rebalance_impl();
+        void publish_impl(TimerStatsWriter &writer, std::uint64_t pid);
+        void unpublish_impl();
+        std::size_t activeSize_impl() const;
+
+        // Engine running the timers of this TimerThread: itself,
+        // or one of the workers of the TimerDomain it is attached to.
+        // The members below, up to the engine state, belong to this
+        // front-end but are protected by the engine's `sync`
+        TimerThread *engine;
+
+        // IDs of the keyed timers of this front-end
+        KeyMap keys;
+
+        // IDs of the timers of this front-end, only
+        // tracked when attached to a TimerDomain
+        std::unordered_set<timer_id_t> owned;
+
+        // Deadline misses of the timers of this front-end
+        std::uint64_t missCount;
+
+        /* Engine state */
+
+        // Inexhaustible source of unique IDs, also
+        // drawn from by the worker without the lock
+        std::atomic<timer_id_t> nextId;
+
+        // Timers created by the handlers through addTimer, added by
+        // the worker without the lock, and merged once the handler
+        // returns. `pendingSync` lets the other threads look into
+        // them with the lock. `pendingLow` is the lowest of their IDs,
+        // `max_timer` if none, so that most lookups skip them.
+        // clearTimer waits on `merged` for a pending or a claimed
+        // timer, and counts in `mergeWaiters`, see idle_impl
+        std::vector<Timer>      pending;
+        mutable TimerSpinLock   pendingSync;
+        std::atomic<timer_id_t> pendingLow;
+        ConditionVar            merged;
+        std::size_t             mergeWaiters;
 
         // The Timer objects are physically stored in this map
         TimerMap active;
@@ -211,6 +765,83 @@ class TimerThread
         // The ordering queue holds references to items in `active`
         Queue queue;
 
+        // The deferrable timers of `queue`, sorted by next release
+        DeferredQueue deferred;
+
+        // Workload profile, if enabled
+        std::unique_ptr<TimerProfiler> profiler;
+
+        // Counters of the timers of all front-ends
+        std::uint64_t createCount;
+        std::uint64_t fireCount;
+        std::uint64_t periodicFireCount;
+        std::uint64_t cancelCount;
+        std::uint64_t missTotal;
+
+        // Timer publishing the stats file, if published.
+        // It owns the writer of the file. It always sits in `active`,
+        // but is left out of size(), empty(), clear() and the pending
+        // count it publishes. statsSync serializes publishStats and
+        // unpublishStats, it is taken before `sync`
+        timer_id_t    statsTimer;
+        std::uint64_t statsUpdates;
+        std::mutex    statsSync;
+
+        // Handler statistics of the labelled timers, and whether the
+        // worker takes the name of the labels while running them
+        std::unordered_map<const char *, LabelStats> labels;
+        bool                                         labelThreadName;
+
+        // Backend the pending timers belong in, and the thresholds
+        // to switch it automatically, if enabled
+        QueueBackend backend;
+        bool         adaptive;
+        std::size_t  wheelAbove;
+        std::size_t  treeBelow;
+        double       wheelCancelRatio;
+
+        // Cancel ratio of the last complete window, and
+        // the finished timers of the current window
+        double        cancelRatio;
+        std::uint32_t windowFires;
+        std::uint32_t windowCancels;
+
+        // FIFO lanes of the timers sharing a duration, whose deadlines
+        // arrive in increasing order. Each lane is an intrusive list,
+        // appended in O(1), and the worker only compares their heads
+        struct Lane {
+            Duration duration;
+            Timer   *head = nullptr;
+            Timer   *tail = nullptr;
+        };
+
+        std::array<Lane, TIMER_LANES> lanes;
+        std::size_t                   laneCount; /* Lanes holding timers */
+
+        // Timing wheel, each slot is an intrusive list of the Timers
+        // whose deadline falls in it, modulo TIMER_WHEEL_SLOTS rounds.
+        // The Timers in the wheel are due at `horizon` or later, the
+        // worker moves a slot into the tree when `horizon` reaches it
+        std::vector<Timer *> wheel;
+        std::size_t          wheelCount;
+        Timestamp            horizon;
+
+        // Next slot scanned to migrate the wheel back into the tree
+        std::size_t migrateSlot;
+
+        // Time until which the worker sleeps, if it does. Read
+        // without the lock by the producers of the staging backends
+        std::atomic<Timestamp> sleepUntil;
+
+        // Staging backends, where producers leave the timers without
+        // the lock, see QueueBackend. The worker collects them as they
+        // come due, and claims the timers of the LocalHeaps backend
+        // that other threads wait for, see claim_impl
+        TimerStaging<Submission> staged;
+
+        // Request records of flat combining
+        Combiner combiner;
+
         // One worker thread for an unlimited number of timers is acceptable
         // Lazily started when first timer is started
         // TODO: Implement auto-stopping the timer thread when it is idle for
@@ -274,4 +905,47 @@ TimerThread::timer_id_t TimerThread::setTimeout(bound_handler_type<Args ...> han
                         timeout);
 }
 
+#if defined(__cpp_lib_jthread)
+inline TimerThread::timer_id_t TimerThread::addTimer(time_us_t       msDelay,
+                                                        time_us_t       msPeriod,
+                                                        handler_type    handler,
+                                                        std::stop_token token)
+{
+    // Sets the flag from the thread requesting the stop
+    struct StopSetter {
+        std::atomic<bool> *flag;
+
+        void operator()() const noexcept
+        {
+            flag->store(true, std::memory_order_release);
+        }
+    };
+
+    // The flag and the callback registered on the token, kept
+    // alive by the Timer. The callback is deregistered when the
+    // Timer is destroyed
+    struct StopHook {
+        explicit StopHook(std::stop_token token)
+            : stopped(false),
+            callback(std::move(token), StopSetter{&stopped})
+        {
+        }
+
+        std::atomic<bool>              stopped;
+        std::stop_callback<StopSetter> callback;
+    };
+
+    if (token.stop_requested()) {
+        return no_timer;
+    }
+
+    auto hook = std::make_shared<StopHook>(std::move(token));
+
+    return addCancellableTimer(msDelay,
+                                msPeriod,
+                                std::move(handler),
+                                std::shared_ptr<std::atomic<bool> const>(hook, &(hook->stopped)));
+}
+#endif /* __cpp_lib_jthread */
+
 #endif /* TIMERTHREAD_HXX */
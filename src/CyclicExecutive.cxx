@@ -0,0 +1,297 @@
+/**
+ * CyclicExecutive class implementation
+ *
+ * @file CyclicExecutive.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "CyclicExecutive.hxx"
+
+#include <algorithm>
+#include <numeric>
+#include <iostream>
+
+#include <cstring>
+#include <cerrno>
+
+#include <time.h>
+#include <pthread.h>
+
+/* Helper functions ------------------------------------ */
+static void timespecAddUs(timespec &pTime, const std::int64_t &pUs)
+{
+    pTime.tv_sec  += static_cast<time_t>(pUs / 1000000);
+    pTime.tv_nsec += static_cast<long>((pUs % 1000000) * 1000);
+    if (pTime.tv_nsec >= 1000000000L) {
+        pTime.tv_nsec -= 1000000000L;
+        ++pTime.tv_sec;
+    }
+}
+
+static std::int64_t timespecDiffUs(const timespec &pA, const timespec &pB)
+{
+    return (static_cast<std::int64_t>(pA.tv_sec) - static_cast<std::int64_t>(pB.tv_sec)) * 1000000
+        + (static_cast<std::int64_t>(pA.tv_nsec) - static_cast<std::int64_t>(pB.tv_nsec)) / 1000;
+}
+
+/* CyclicExecutive implementation ---------------------- */
+void CyclicExecutive::cyclicExecutiveWorker()
+{
+    std::size_t const lFrameCount = frames.size() - 1U;
+    std::size_t       lFrame      = 0U;
+    timespec          lRelease;
+    timespec          lNow;
+
+    // The first frame is released right away, the following
+    // ones are released at absolute times derived from it, so
+    // the jitter of one frame does not drift the next ones
+    clock_gettime(CLOCK_MONOTONIC, &lRelease);
+
+    while (!done.load(std::memory_order_acquire)) {
+        while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &lRelease, nullptr)) {
+            // Interrupted by a signal, go back to sleep
+        }
+
+        for (std::size_t i = frames[lFrame]; i < frames[lFrame + 1U]; ++i) {
+            tasks[table[i]].handler();
+        }
+
+        // The frame must complete before the next release
+        timespecAddUs(lRelease, minor);
+        clock_gettime(CLOCK_MONOTONIC, &lNow);
+
+        std::int64_t const lOverrun = timespecDiffUs(lNow, lRelease);
+        if (lOverrun > 0) {
+            overrunCount.fetch_add(1U, std::memory_order_relaxed);
+
+            if (overrunHandler) {
+                overrunHandler(lFrame, lOverrun);
+            }
+        }
+
+        lFrame = (lFrame + 1U) % lFrameCount;
+    }
+}
+
+int CyclicExecutive::buildTable()
+{
+    std::vector<std::size_t> lOrder(tasks.size());
+
+    // Rate-monotonic order within a frame,
+    // registration order between equal periods
+    std::iota(lOrder.begin(), lOrder.end(), 0U);
+    std::stable_sort(lOrder.begin(), lOrder.end(),
+                        [this](std::size_t a, std::size_t b) {
+                            return tasks[a].period < tasks[b].period;
+                        });
+
+    // With harmonic periods, the GCD is the shortest period
+    // and the LCM is the longest one
+    for (std::size_t i = 1U; i < lOrder.size(); ++i) {
+        if (0 != (tasks[lOrder[i]].period % tasks[lOrder[i - 1U]].period)) {
+            std::cerr << "[ERROR] <CyclicExecutive> Periods " << tasks[lOrder[i - 1U]].period
+                      << " and " << tasks[lOrder[i]].period << " are not harmonic" << std::endl;
+            return 255; /* ERROR */
+        }
+    }
+
+    minor = tasks[lOrder.front()].period;
+    major = tasks[lOrder.back()].period;
+
+    std::size_t const lFrameCount = static_cast<std::size_t>(major / minor);
+
+    frames.clear();
+    table.clear();
+    frames.reserve(lFrameCount + 1U);
+
+    for (std::size_t f = 0U; f < lFrameCount; ++f) {
+        frames.push_back(table.size());
+
+        for (const std::size_t &i : lOrder) {
+            if (0U == (f % static_cast<std::size_t>(tasks[i].period / minor))) {
+                table.push_back(i);
+            }
+        }
+    }
+    frames.push_back(table.size());
+
+    return 0;
+}
+
+CyclicExecutive::CyclicExecutive()
+    : minor(0),
+    major(0),
+    stopping(false),
+    done(true),
+    overrunCount(0U)
+{
+}
+
+CyclicExecutive::~CyclicExecutive()
+{
+    stop();
+}
+
+CyclicExecutive::task_id_t CyclicExecutive::addTask(handler_type handler, time_us_t period)
+{
+    ScopedLock lock(sync);
+
+    if (worker.joinable() || stopping) {
+        std::cerr << "[ERROR] <CyclicExecutive::addTask> Cannot add a task while running" << std::endl;
+        return no_task;
+    } else if (0 >= period) {
+        std::cerr << "[ERROR] <CyclicExecutive::addTask> Period must be positive" << std::endl;
+        return no_task;
+    } else if (!handler) {
+        std::cerr << "[ERROR] <CyclicExecutive::addTask> Handler is empty" << std::endl;
+        return no_task;
+    }
+
+    tasks.push_back(Task{std::move(handler), period});
+
+    return tasks.size() - 1U;
+}
+
+int CyclicExecutive::setOverrunHandler(overrun_handler_type handler)
+{
+    ScopedLock lock(sync);
+
+    if (worker.joinable() || stopping) {
+        std::cerr << "[ERROR] <CyclicExecutive::setOverrunHandler> Cannot set the handler while running" << std::endl;
+        return 255; /* ERROR */
+    }
+
+    overrunHandler = std::move(handler);
+
+    return 0;
+}
+
+int CyclicExecutive::start()
+{
+    ScopedLock lock(sync);
+
+    if (worker.joinable() || stopping) {
+        std::cerr << "[ERROR] <CyclicExecutive::start> Already running" << std::endl;
+        return 255; /* ERROR */
+    } else if (tasks.empty()) {
+        std::cerr << "[ERROR] <CyclicExecutive::start> No task registered" << std::endl;
+        return 255; /* ERROR */
+    }
+
+    if (0 != buildTable()) {
+        return 255; /* ERROR */
+    }
+
+    overrunCount.store(0U, std::memory_order_relaxed);
+    done.store(false, std::memory_order_release);
+    worker = std::thread(&CyclicExecutive::cyclicExecutiveWorker, this);
+
+    return 0;
+}
+
+int CyclicExecutive::stop()
+{
+    ScopedLock lock(sync);
+
+    // The worker might not be running
+    if (!worker.joinable()) {
+        return 0;
+    } else if (std::this_thread::get_id() == worker.get_id()) {
+        std::cerr << "[ERROR] <CyclicExecutive::stop> Cannot stop from a handler" << std::endl;
+        return 255; /* ERROR */
+    }
+
+    // The worker notices it at the end of the current frame.
+    // The configuration stays locked until it is joined, but
+    // the lock is released so that the other calls don't wait
+    std::thread lWorker = std::move(worker);
+
+    done.store(true, std::memory_order_release);
+    stopping = true;
+    lock.unlock();
+
+    lWorker.join();
+
+    lock.lock();
+    stopping = false;
+
+    return 0;
+}
+
+int CyclicExecutive::setScheduling(const int &pPolicy, const int &pPriority)
+{
+    sched_param sch_params;
+    int         res = 0;
+
+    sch_params.sched_priority = pPriority;
+
+    res = pthread_setschedparam(worker.native_handle(), pPolicy, &sch_params);
+    if (res) {
+        std::cerr << "[ERROR] <CyclicExecutive> Failed to set Thread scheduling : " << std::strerror(res) << std::endl;
+    }
+
+    return res;
+}
+
+int CyclicExecutive::scheduling(int * const pPolicy, int * const pPriority) noexcept
+{
+    sched_param sch_params;
+    int         res = 0;
+
+    /* Checking arguments */
+    if (nullptr == pPolicy) {
+        std::cerr << "[ERROR] <CyclicExecutive::scheduling> pPolicy = nullptr !" << std::endl;
+        return 255; /* ERROR */
+    } else if (nullptr == pPriority) {
+        std::cerr << "[ERROR] <CyclicExecutive::scheduling> pPriority = nullptr !" << std::endl;
+        return 255; /* ERROR */
+    }
+
+    res = pthread_getschedparam(worker.native_handle(), pPolicy, &sch_params);
+    if (res) {
+        std::cerr << "[ERROR] <CyclicExecutive> Failed to get Thread scheduling : " << std::strerror(res) << std::endl;
+        *pPriority = 0; /* 0 not possible, indicates an error */
+    } else {
+        *pPriority = sch_params.sched_priority; /* Should be between 1 & 99 */
+    }
+
+    return res;
+}
+
+bool CyclicExecutive::running() const noexcept
+{
+    return !done.load(std::memory_order_acquire);
+}
+
+CyclicExecutive::time_us_t CyclicExecutive::minorFrame() const noexcept
+{
+    ScopedLock lock(sync);
+
+    return minor;
+}
+
+CyclicExecutive::time_us_t CyclicExecutive::majorFrame() const noexcept
+{
+    ScopedLock lock(sync);
+
+    return major;
+}
+
+std::size_t CyclicExecutive::frameCount() const noexcept
+{
+    ScopedLock lock(sync);
+
+    return frames.empty() ? 0U : frames.size() - 1U;
+}
+
+std::size_t CyclicExecutive::taskCount() const noexcept
+{
+    ScopedLock lock(sync);
+
+    return tasks.size();
+}
+
+std::uint64_t CyclicExecutive::overruns() const noexcept
+{
+    return overrunCount.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,184 @@
+/**
+ * IdleSweeper class implementation
+ *
+ * @file IdleSweeper.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "IdleSweeper.hxx"
+
+#include <chrono>
+
+/* Defines --------------------------------------------- */
+#define IDLE_SWEEPER_BLOCK 64U /* Slots counted at once by the sweep */
+
+/* IdleSweeper implementation -------------------------- */
+IdleSweeper::IdleSweeper(std::size_t         capacity,
+                            time_us_t           idleTimeout,
+                            time_us_t           granularity,
+                            expiry_handler_type handler,
+                            TimerThread        &timerThread)
+    : idleTimeout(idleTimeout),
+    lastActivity(nullptr),
+    slotCapacity(capacity),
+    slots(0U),
+    openSlots(0U),
+    handler(std::move(handler)),
+    timerThread(timerThread),
+    sweeper(TimerThread::no_timer)
+{
+    std::size_t const lSize = ((capacity + IDLE_SWEEPER_BLOCK - 1U) / IDLE_SWEEPER_BLOCK) * IDLE_SWEEPER_BLOCK;
+
+    lastActivity.reset(new std::atomic<std::int64_t>[lSize]);
+
+    for (std::size_t i = 0U; i < lSize; ++i) {
+        lastActivity[i].store(closed, std::memory_order_relaxed);
+    }
+
+    sweeper = timerThread.setInterval([this]() {
+                                            ScopedLock lock(sync);
+                                            sweep_impl(lock);
+                                        },
+                                        granularity);
+}
+
+IdleSweeper::~IdleSweeper()
+{
+    // Synchronizes with a sweep in progress
+    timerThread.clearTimer(sweeper);
+}
+
+IdleSweeper::slot_t IdleSweeper::open()
+{
+    ScopedLock lock(sync);
+    slot_t     slot = no_slot;
+
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else if (slots < slotCapacity) {
+        slot = slots++;
+    } else {
+        return no_slot;
+    }
+
+    ++openSlots;
+    lastActivity[slot].store(now(), std::memory_order_relaxed);
+
+    return slot;
+}
+
+bool IdleSweeper::close(slot_t slot)
+{
+    ScopedLock lock(sync);
+
+    if (slot >= slots) {
+        return false;
+    }
+
+    // Racing touch() calls see the slot closed
+    if (closed == lastActivity[slot].exchange(closed, std::memory_order_relaxed)) {
+        return false;
+    }
+
+    --openSlots;
+    freeSlots.push_back(slot);
+
+    return true;
+}
+
+void IdleSweeper::touch(slot_t slot) noexcept
+{
+    // The capacity never changes, so it is read without the lock
+    if (slot >= slotCapacity) {
+        return;
+    }
+
+    std::int64_t       last    = lastActivity[slot].load(std::memory_order_relaxed);
+    std::int64_t const current = now();
+
+    // Never store over a closed slot, the sweep might have
+    // expired it since we loaded its timestamp
+    while ((closed != last) && (last < current)) {
+        if (lastActivity[slot].compare_exchange_weak(last, current, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+}
+
+void IdleSweeper::sweep()
+{
+    ScopedLock lock(sync);
+
+    sweep_impl(lock);
+}
+
+std::size_t IdleSweeper::size() const noexcept
+{
+    ScopedLock lock(sync);
+
+    return openSlots;
+}
+
+std::size_t IdleSweeper::capacity() const noexcept
+{
+    return slotCapacity;
+}
+
+std::int64_t IdleSweeper::now() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// NOTE: returns with the lock held, but releases it while
+// the expiry handler is called for the idle slots
+void IdleSweeper::sweep_impl(ScopedLock &lock)
+{
+    std::int64_t const  limit = now() - idleTimeout;
+    std::vector<slot_t> expired;
+
+    for (std::size_t block = 0U; block < slots; block += IDLE_SWEEPER_BLOCK) {
+        // Count the idle candidates of the block, closed slots
+        // hold INT64_MAX and never match.
+        // Relaxed loads are enough to find candidates, a stale
+        // value is caught by the exchange below
+        unsigned int candidates = 0U;
+        for (std::size_t i = 0U; i < IDLE_SWEEPER_BLOCK; ++i) {
+            candidates += (lastActivity[block + i].load(std::memory_order_relaxed) < limit) ? 1U : 0U;
+        }
+
+        if (0U == candidates) {
+            continue;
+        }
+
+        for (std::size_t i = block; i < block + IDLE_SWEEPER_BLOCK; ++i) {
+            std::int64_t last = lastActivity[i].load(std::memory_order_relaxed);
+
+            // Closing the slot fails if a touch() got in first
+            if ((last < limit)
+                && lastActivity[i].compare_exchange_strong(last, closed, std::memory_order_relaxed))
+            {
+                expired.push_back(i);
+            }
+        }
+    }
+
+    if (expired.empty()) {
+        return;
+    }
+
+    openSlots -= expired.size();
+
+    // Call the handler outside the lock, it may open or close
+    // slots. The expired slots are only reused afterwards, so
+    // the handler can still map them to its connections
+    lock.unlock();
+
+    for (const slot_t &slot : expired) {
+        handler(slot);
+    }
+
+    lock.lock();
+
+    freeSlots.insert(freeSlots.end(), expired.begin(), expired.end());
+}
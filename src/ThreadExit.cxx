@@ -0,0 +1,47 @@
+/**
+ * ThreadExit class implementation
+ *
+ * @file ThreadExit.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "ThreadExit.hxx"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+/* Thread exit hooks ----------------------------------- */
+// Handlers of the calling thread, called by the destructor of
+// the thread_local instance when the thread exits
+struct ThreadExitHooks {
+    using Hook = std::pair<std::weak_ptr<void>, ThreadExit::handler_type>;
+
+    ~ThreadExitHooks()
+    {
+        for (Hook &hook : hooks) {
+            if (std::shared_ptr<void> owner = hook.first.lock()) {
+                hook.second();
+            }
+        }
+    }
+
+    std::vector<Hook> hooks;
+};
+
+static thread_local ThreadExitHooks sHooks;
+
+/* ThreadExit implementation --------------------------- */
+void ThreadExit::atExit(std::weak_ptr<void> owner, handler_type handler)
+{
+    std::vector<ThreadExitHooks::Hook> &hooks = sHooks.hooks;
+
+    // A thread may outlive many owners
+    hooks.erase(std::remove_if(hooks.begin(), hooks.end(),
+                                [](ThreadExitHooks::Hook const &hook) {
+                                    return hook.first.expired();
+                                }),
+                hooks.end());
+
+    hooks.emplace_back(std::move(owner), std::move(handler));
+}
@@ -0,0 +1,126 @@
+/**
+ * TimerBatch class implementation
+ *
+ * @file TimerBatch.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "TimerBatch.hxx"
+
+#include <algorithm>
+
+/* TimerBatch implementation --------------------------- */
+TimerBatch::TimerBatch(std::size_t  maxOps,
+                        time_us_t    maxAge,
+                        TimerThread &timerThread)
+    : maxOps(maxOps),
+    maxAge(maxAge),
+    adds(),
+    clears(),
+    oldest(),
+    timerThread(timerThread)
+{
+    /* Empty */
+}
+
+TimerBatch::~TimerBatch()
+{
+    flush();
+}
+
+TimerBatch::timer_id_t TimerBatch::addTimer(time_us_t    msDelay,
+                                            time_us_t    msPeriod,
+                                            handler_type handler)
+{
+    Timestamp const  now = Clock::now();
+    timer_id_t const id  = timerThread.reserve_impl();
+
+    adds.push_back(Submission{id,
+                                now + Duration(msDelay),
+                                Duration(msDelay),
+                                Duration(msPeriod),
+                                std::move(handler)});
+
+    buffered_impl(now);
+
+    return id;
+}
+
+TimerBatch::timer_id_t TimerBatch::setInterval(handler_type handler,
+                                                time_us_t    msPeriod)
+{
+    return addTimer(msPeriod, msPeriod, std::move(handler));
+}
+
+TimerBatch::timer_id_t TimerBatch::setTimeout(handler_type handler,
+                                                time_us_t    msDelay)
+{
+    return addTimer(msDelay, 0, std::move(handler));
+}
+
+bool TimerBatch::clearTimer(timer_id_t id)
+{
+    // The IDs are reserved in increasing order
+    auto i = std::lower_bound(adds.begin(), adds.end(), id,
+                                [](Submission const &submission, timer_id_t const &pId) {
+                                    return submission.id < pId;
+                                });
+
+    if ((i != adds.end()) && (i->id == id)) {
+        // The TimerThread never sees this timer
+        adds.erase(i);
+
+        return true;
+    }
+
+    clears.push_back(id);
+    buffered_impl(Clock::now());
+
+    return false;
+}
+
+void TimerBatch::flush()
+{
+    if (adds.empty() && clears.empty()) {
+        return;
+    }
+
+    timerThread.submit_impl(adds, clears);
+
+    adds.clear();
+    clears.clear();
+}
+
+std::size_t TimerBatch::size() const noexcept
+{
+    return adds.size() + clears.size();
+}
+
+bool TimerBatch::empty() const noexcept
+{
+    return adds.empty() && clears.empty();
+}
+
+TimerBatch &TimerBatch::local()
+{
+    static thread_local TimerBatch batch;
+
+    return batch;
+}
+
+// Called once an operation is buffered, flushes
+// the batch if it reached one of its limits
+void TimerBatch::buffered_impl(Timestamp now)
+{
+    std::size_t const lSize = size();
+
+    if (1U == lSize) {
+        oldest = now;
+    }
+
+    if (((0U < maxOps) && (lSize >= maxOps))
+        || ((0 < maxAge.count()) && (now - oldest >= maxAge)))
+    {
+        flush();
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ * TimerDomain class implementation
+ *
+ * @file TimerDomain.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "TimerDomain.hxx"
+
+/* TimerDomain implementation -------------------------- */
+TimerDomain::TimerDomain(std::size_t             workers,
+                            TimerThread::LockPolicy lockPolicy)
+    : nextEngine(0U)
+{
+    if (0U == workers) {
+        workers = 1U;
+    }
+
+    for (std::size_t i = 0U; i < workers; ++i) {
+        engines.emplace_back(new TimerThread(lockPolicy));
+    }
+}
+
+TimerDomain::~TimerDomain()
+{
+    // Each engine stops its worker when destroyed
+}
+
+int TimerDomain::setScheduling(const int &pPolicy, const int &pPriority)
+{
+    int res = 0;
+
+    for (std::unique_ptr<TimerThread> &engine : engines) {
+        int const lRes = engine->setScheduling(pPolicy, pPriority);
+
+        if (0 != lRes) {
+            res = lRes;
+        }
+    }
+
+    return res;
+}
+
+std::size_t TimerDomain::workers() const noexcept
+{
+    return engines.size();
+}
+
+std::size_t TimerDomain::size() const noexcept
+{
+    std::size_t lSize = 0U;
+
+    // Timers of all attached TimerThreads
+    for (const std::unique_ptr<TimerThread> &engine : engines) {
+        lSize += engine->size();
+    }
+
+    return lSize;
+}
+
+TimerThread *TimerDomain::attach() noexcept
+{
+    std::size_t const i = nextEngine.fetch_add(1U, std::memory_order_relaxed);
+
+    return engines[i % engines.size()].get();
+}
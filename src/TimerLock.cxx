@@ -0,0 +1,203 @@
+/**
+ * TimerLock and TimerCondition class implementations
+ *
+ * @file TimerLock.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "TimerLock.hxx"
+
+#include <system_error>
+#include <algorithm>
+#include <thread>
+
+#include <cerrno>
+
+/* Helper functions ------------------------------------ */
+static inline void cpuRelax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__ ("yield");
+#endif
+}
+
+/* TimerLock implementation ---------------------------- */
+TimerLock::TimerLock(Policy policy)
+    : lockPolicy(policy),
+    held(false),
+    spins(TIMER_LOCK_MAX_SPINS / 2)
+{
+    pthread_mutexattr_t lAttr;
+    int                 res = 0;
+
+    pthread_mutexattr_init(&lAttr);
+
+    if (Policy::PriorityInheritance == policy) {
+        res = pthread_mutexattr_setprotocol(&lAttr, PTHREAD_PRIO_INHERIT);
+    }
+
+    if (0 == res) {
+        res = pthread_mutex_init(&mutex, &lAttr);
+    }
+
+    pthread_mutexattr_destroy(&lAttr);
+
+    if (0 != res) {
+        throw std::system_error(res, std::system_category(), "TimerLock");
+    }
+}
+
+TimerLock::~TimerLock()
+{
+    pthread_mutex_destroy(&mutex);
+}
+
+void TimerLock::lock()
+{
+    if (Policy::AdaptiveSpin == lockPolicy) {
+        if (0 == pthread_mutex_trylock(&mutex)) {
+            held.store(true, std::memory_order_relaxed);
+            return;
+        }
+
+        // Spin a bit longer than what was needed recently, so
+        // the bound follows the length of the critical sections
+        int const lMax     = std::min(2 * spins.load(std::memory_order_relaxed) + 10, TIMER_LOCK_MAX_SPINS);
+        int       lAttempt = 0;
+        bool      lLocked  = false;
+
+        // Wait for the mutex to look free before trying to take
+        // it, reading the flag keeps its cache line shared
+        while (!lLocked && (lAttempt < lMax)) {
+            ++lAttempt;
+            cpuRelax();
+            lLocked = !held.load(std::memory_order_relaxed) && (0 == pthread_mutex_trylock(&mutex));
+        }
+
+        int const lSpins = spins.load(std::memory_order_relaxed);
+        spins.store(lSpins + ((lAttempt - lSpins) / 8), std::memory_order_relaxed);
+
+        if (lLocked) {
+            held.store(true, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    // Sleep on the futex
+    int const res = pthread_mutex_lock(&mutex);
+
+    if (0 != res) {
+        throw std::system_error(res, std::system_category(), "TimerLock::lock");
+    }
+
+    held.store(true, std::memory_order_relaxed);
+}
+
+bool TimerLock::try_lock() noexcept
+{
+    if (0 != pthread_mutex_trylock(&mutex)) {
+        return false;
+    }
+
+    held.store(true, std::memory_order_relaxed);
+
+    return true;
+}
+
+void TimerLock::unlock() noexcept
+{
+    held.store(false, std::memory_order_relaxed);
+    pthread_mutex_unlock(&mutex);
+}
+
+TimerLock::Policy TimerLock::policy() const noexcept
+{
+    return lockPolicy;
+}
+
+pthread_mutex_t *TimerLock::native_handle() noexcept
+{
+    return &mutex;
+}
+
+/* TimerSpinLock implementation ------------------------ */
+TimerSpinLock::TimerSpinLock() noexcept
+    : locked(false)
+{
+    /* Empty */
+}
+
+void TimerSpinLock::lock() noexcept
+{
+    int lAttempt = 0;
+
+    while (locked.exchange(true, std::memory_order_acquire)) {
+        // Wait for the owner without bouncing the cache line
+        while (locked.load(std::memory_order_relaxed)) {
+            if (TIMER_LOCK_MAX_SPINS <= ++lAttempt) {
+                lAttempt = 0;
+                std::this_thread::yield();
+            } else {
+                cpuRelax();
+            }
+        }
+    }
+}
+
+bool TimerSpinLock::try_lock() noexcept
+{
+    return !locked.load(std::memory_order_relaxed)
+           && !locked.exchange(true, std::memory_order_acquire);
+}
+
+void TimerSpinLock::unlock() noexcept
+{
+    locked.store(false, std::memory_order_release);
+}
+
+/* TimerCondition implementation ----------------------- */
+TimerCondition::TimerCondition()
+{
+    pthread_condattr_t lAttr;
+
+    pthread_condattr_init(&lAttr);
+    pthread_condattr_setclock(&lAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond, &lAttr);
+    pthread_condattr_destroy(&lAttr);
+}
+
+TimerCondition::~TimerCondition()
+{
+    pthread_cond_destroy(&cond);
+}
+
+void TimerCondition::wait(ScopedLock &lock)
+{
+    // The mutex is released while waiting
+    lock.mutex()->held.store(false, std::memory_order_relaxed);
+    pthread_cond_wait(&cond, lock.mutex()->native_handle());
+    lock.mutex()->held.store(true, std::memory_order_relaxed);
+}
+
+std::cv_status TimerCondition::wait_until_monotonic(ScopedLock &lock, timespec const &deadline)
+{
+    lock.mutex()->held.store(false, std::memory_order_relaxed);
+
+    int const res = pthread_cond_timedwait(&cond, lock.mutex()->native_handle(), &deadline);
+
+    lock.mutex()->held.store(true, std::memory_order_relaxed);
+
+    return (ETIMEDOUT == res) ? std::cv_status::timeout : std::cv_status::no_timeout;
+}
+
+void TimerCondition::notify_one() noexcept
+{
+    pthread_cond_signal(&cond);
+}
+
+void TimerCondition::notify_all() noexcept
+{
+    pthread_cond_broadcast(&cond);
+}
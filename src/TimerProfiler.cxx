@@ -0,0 +1,274 @@
+/**
+ * TimerProfiler class implementation
+ *
+ * @file TimerProfiler.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "TimerProfiler.hxx"
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+/* Defines --------------------------------------------- */
+#define TIMER_PROFILER_WHEEL_PENDING   1024U /* Pending timers above which a wheel pays off */
+#define TIMER_PROFILER_WHEEL_CHURN     0.5   /* Cancel or reset ratio above which a wheel pays off */
+#define TIMER_PROFILER_RESOLUTION_DIV  64    /* Tick resolution relative to the short delays */
+
+/* Helper functions ------------------------------------ */
+static void printHistogram(std::ostream &os, const char *title, TimerProfiler::Histogram const &histogram)
+{
+    std::uint64_t lTotal = 0U;
+
+    for (std::uint64_t count : histogram) {
+        lTotal += count;
+    }
+
+    os << title << " (" << lTotal << ")" << std::endl;
+
+    if (0U == lTotal) {
+        return;
+    }
+
+    for (std::size_t b = 0U; b < TimerProfiler::buckets; ++b) {
+        if (0U == histogram[b]) {
+            continue;
+        }
+
+        std::uint64_t const lLow  = (0U == b) ? 0U : (1ULL << (b - 1U));
+        std::uint64_t const lHigh = 1ULL << b;
+
+        os << "  [" << std::setw(12) << lLow << ", " << std::setw(12) << lHigh << ") us : "
+            << std::setw(12) << histogram[b]
+            << std::setw(8) << std::fixed << std::setprecision(1)
+            << (100.0 * static_cast<double>(histogram[b]) / static_cast<double>(lTotal)) << " %"
+            << std::endl;
+    }
+}
+
+/* TimerProfiler implementation ------------------------ */
+TimerProfiler::TimerProfiler()
+    : delayHistogram(),
+    firedHistogram(),
+    cancelledHistogram(),
+    creationCount(0U),
+    periodicCount(0U),
+    fireCount(0U),
+    periodicFireCount(0U),
+    cancelCount(0U),
+    resetCount(0U),
+    pendingPeak(0U)
+{
+}
+
+void TimerProfiler::created(time_us_t delay, time_us_t period, std::size_t pending) noexcept
+{
+    ++creationCount;
+    ++delayHistogram[bucket(delay)];
+
+    if (period > 0) {
+        ++periodicCount;
+    }
+
+    pendingPeak = std::max(pendingPeak, pending);
+}
+
+void TimerProfiler::fired(time_us_t lifetime) noexcept
+{
+    ++fireCount;
+    ++firedHistogram[bucket(lifetime)];
+}
+
+void TimerProfiler::periodicFired() noexcept
+{
+    ++periodicFireCount;
+}
+
+void TimerProfiler::cancelled(time_us_t lifetime) noexcept
+{
+    ++cancelCount;
+    ++cancelledHistogram[bucket(lifetime)];
+}
+
+void TimerProfiler::reset() noexcept
+{
+    ++resetCount;
+}
+
+TimerProfiler::Histogram const &TimerProfiler::delays() const noexcept
+{
+    return delayHistogram;
+}
+
+TimerProfiler::Histogram const &TimerProfiler::firedLifetimes() const noexcept
+{
+    return firedHistogram;
+}
+
+TimerProfiler::Histogram const &TimerProfiler::cancelledLifetimes() const noexcept
+{
+    return cancelledHistogram;
+}
+
+std::uint64_t TimerProfiler::creations() const noexcept
+{
+    return creationCount;
+}
+
+std::uint64_t TimerProfiler::periodics() const noexcept
+{
+    return periodicCount;
+}
+
+std::uint64_t TimerProfiler::fires() const noexcept
+{
+    return fireCount;
+}
+
+std::uint64_t TimerProfiler::periodicFires() const noexcept
+{
+    return periodicFireCount;
+}
+
+std::uint64_t TimerProfiler::cancels() const noexcept
+{
+    return cancelCount;
+}
+
+std::uint64_t TimerProfiler::resets() const noexcept
+{
+    return resetCount;
+}
+
+std::size_t TimerProfiler::peakPending() const noexcept
+{
+    return pendingPeak;
+}
+
+double TimerProfiler::cancelRatio() const noexcept
+{
+    std::uint64_t const lFinished = fireCount + cancelCount;
+
+    return (0U == lFinished) ? 0.0 : static_cast<double>(cancelCount) / static_cast<double>(lFinished);
+}
+
+double TimerProfiler::resetRatio() const noexcept
+{
+    std::uint64_t const lRequests = creationCount + resetCount;
+
+    return (0U == lRequests) ? 0.0 : static_cast<double>(resetCount) / static_cast<double>(lRequests);
+}
+
+TimerProfiler::time_us_t TimerProfiler::quantile(Histogram const &histogram, double q) noexcept
+{
+    std::uint64_t lTotal = 0U;
+
+    for (std::uint64_t count : histogram) {
+        lTotal += count;
+    }
+
+    if (0U == lTotal) {
+        return 0;
+    }
+
+    q = std::min(std::max(q, 0.0), 1.0);
+
+    // Rank of the quantile, at least the first value
+    std::uint64_t const lRank = std::max<std::uint64_t>(1U, static_cast<std::uint64_t>(q * static_cast<double>(lTotal) + 0.5));
+    std::uint64_t       lSeen = 0U;
+
+    for (std::size_t b = 0U; b < buckets; ++b) {
+        lSeen += histogram[b];
+
+        if (lSeen >= lRank) {
+            return (b >= 63U) ? INT64_MAX : static_cast<time_us_t>(1ULL << b);
+        }
+    }
+
+    return INT64_MAX;
+}
+
+const char *TimerProfiler::recommendedBackend() const noexcept
+{
+    // Most timers never fire (timeouts, keep-alives): a timing
+    // wheel inserts and cancels in O(1), which only pays off
+    // over the tree with many pending timers
+    bool const lChurn = (cancelRatio() > TIMER_PROFILER_WHEEL_CHURN)
+                        || (resetRatio() > TIMER_PROFILER_WHEEL_CHURN);
+
+    if (lChurn && (pendingPeak >= TIMER_PROFILER_WHEEL_PENDING)) {
+        return "wheel";
+    }
+
+    return "tree";
+}
+
+TimerProfiler::time_us_t TimerProfiler::recommendedResolution() const noexcept
+{
+    // Keep the rounding error small in front of the short delays
+    time_us_t const lShort = quantile(delayHistogram, 0.1) / TIMER_PROFILER_RESOLUTION_DIV;
+    time_us_t       lTick  = 1;
+
+    while ((lTick * 2) <= lShort) {
+        lTick *= 2;
+    }
+
+    return lTick;
+}
+
+std::size_t TimerProfiler::recommendedWheelLevels() const noexcept
+{
+    // Enough levels to hold the long delays without overflowing
+    time_us_t const lLong  = quantile(delayHistogram, 0.99);
+    time_us_t       lSpan  = recommendedResolution();
+    std::size_t     lLevel = 1U;
+
+    while ((lSpan <= lLong / static_cast<time_us_t>(wheelSlots)) && (lLevel < 8U)) {
+        lSpan *= static_cast<time_us_t>(wheelSlots);
+        ++lLevel;
+    }
+
+    return lLevel;
+}
+
+std::string TimerProfiler::report() const
+{
+    std::ostringstream os;
+
+    os << "Timers created     : " << creationCount << " (" << periodicCount << " periodic)" << std::endl;
+    os << "Timers fired       : " << fireCount << " (+ " << periodicFireCount << " periodic releases)" << std::endl;
+    os << "Timers cancelled   : " << cancelCount << std::endl;
+    os << "Keyed timer resets : " << resetCount << std::endl;
+    os << "Peak pending       : " << pendingPeak << std::endl;
+    os << std::fixed << std::setprecision(3);
+    os << "Cancel ratio       : " << cancelRatio() << std::endl;
+    os << "Reset ratio        : " << resetRatio() << std::endl;
+
+    printHistogram(os, "Requested delays", delayHistogram);
+    printHistogram(os, "Lifetimes before fire", firedHistogram);
+    printHistogram(os, "Lifetimes before cancel", cancelledHistogram);
+
+    if (0U == creationCount) {
+        os << "Recommendation     : no timers profiled" << std::endl;
+        return os.str();
+    }
+
+    os << "Recommended backend    : " << recommendedBackend() << std::endl;
+    os << "Recommended resolution : " << recommendedResolution() << " us" << std::endl;
+    os << "Recommended wheel      : " << recommendedWheelLevels() << " level(s) of "
+        << wheelSlots << " slots" << std::endl;
+
+    return os.str();
+}
+
+std::size_t TimerProfiler::bucket(time_us_t value) noexcept
+{
+    if (value <= 0) {
+        return 0U;
+    }
+
+    // 2^(b-1) <= value < 2^b
+    return std::min<std::size_t>(64U - static_cast<std::size_t>(__builtin_clzll(static_cast<unsigned long long>(value))),
+                                    buckets - 1U);
+}
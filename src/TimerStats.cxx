@@ -0,0 +1,204 @@
+/**
+ * TimerStatsWriter and TimerStatsReader class implementations
+ *
+ * @file TimerStats.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "TimerStats.hxx"
+
+#include <iostream>
+#include <new>
+
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Defines --------------------------------------------- */
+#define TIMER_STATS_READ_RETRIES 1000 /* Attempts to read a consistent snapshot */
+
+/* TimerStatsWriter implementation --------------------- */
+TimerStatsWriter::TimerStatsWriter()
+    : page(nullptr)
+{
+}
+
+TimerStatsWriter::~TimerStatsWriter()
+{
+    close();
+}
+
+int TimerStatsWriter::open(const char * const pPath)
+{
+    if (nullptr == pPath) {
+        std::cerr << "[ERROR] <TimerStatsWriter::open> pPath = nullptr !" << std::endl;
+        return 255; /* ERROR */
+    }
+
+    close();
+
+    int const lFd = ::open(pPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (0 > lFd) {
+        std::cerr << "[ERROR] <TimerStatsWriter::open> Failed to open " << pPath << " : " << std::strerror(errno) << std::endl;
+        return 255; /* ERROR */
+    }
+
+    if (0 != ftruncate(lFd, sizeof(TimerStatsPage))) {
+        std::cerr << "[ERROR] <TimerStatsWriter::open> Failed to size " << pPath << " : " << std::strerror(errno) << std::endl;
+        ::close(lFd);
+        return 255; /* ERROR */
+    }
+
+    void * const lMap = mmap(nullptr, sizeof(TimerStatsPage), PROT_READ | PROT_WRITE, MAP_SHARED, lFd, 0);
+
+    // The mapping stays valid once the file is closed
+    ::close(lFd);
+
+    if (MAP_FAILED == lMap) {
+        std::cerr << "[ERROR] <TimerStatsWriter::open> Failed to map " << pPath << " : " << std::strerror(errno) << std::endl;
+        return 255; /* ERROR */
+    }
+
+    // The file is zero filled, so the sequence starts even.
+    // Readers check the magic number last
+    page          = new (lMap) TimerStatsPage;
+    page->version = TIMER_STATS_VERSION;
+    page->size    = sizeof(TimerStatsPage);
+    page->sequence.store(0U, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    page->magic   = TIMER_STATS_MAGIC;
+
+    return 0;
+}
+
+void TimerStatsWriter::close() noexcept
+{
+    if (nullptr != page) {
+        munmap(page, sizeof(TimerStatsPage));
+        page = nullptr;
+    }
+}
+
+void TimerStatsWriter::write(TimerStatsData const &pData) noexcept
+{
+    if (nullptr == page) {
+        return;
+    }
+
+    std::uint64_t const lSequence = page->sequence.load(std::memory_order_relaxed);
+
+    // Odd while the data is being updated
+    page->sequence.store(lSequence + 1U, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::memcpy(&page->data, &pData, sizeof(TimerStatsData));
+
+    page->sequence.store(lSequence + 2U, std::memory_order_release);
+}
+
+bool TimerStatsWriter::isOpen() const noexcept
+{
+    return nullptr != page;
+}
+
+/* TimerStatsReader implementation --------------------- */
+TimerStatsReader::TimerStatsReader()
+    : page(nullptr)
+{
+}
+
+TimerStatsReader::~TimerStatsReader()
+{
+    close();
+}
+
+int TimerStatsReader::open(const char * const pPath)
+{
+    if (nullptr == pPath) {
+        std::cerr << "[ERROR] <TimerStatsReader::open> pPath = nullptr !" << std::endl;
+        return 255; /* ERROR */
+    }
+
+    close();
+
+    int const lFd = ::open(pPath, O_RDONLY | O_CLOEXEC);
+    if (0 > lFd) {
+        std::cerr << "[ERROR] <TimerStatsReader::open> Failed to open " << pPath << " : " << std::strerror(errno) << std::endl;
+        return 255; /* ERROR */
+    }
+
+    struct stat lStat;
+    if ((0 != fstat(lFd, &lStat)) || (sizeof(TimerStatsPage) > static_cast<std::size_t>(lStat.st_size))) {
+        std::cerr << "[ERROR] <TimerStatsReader::open> " << pPath << " is not a stats page" << std::endl;
+        ::close(lFd);
+        return 255; /* ERROR */
+    }
+
+    void * const lMap = mmap(nullptr, sizeof(TimerStatsPage), PROT_READ, MAP_SHARED, lFd, 0);
+
+    ::close(lFd);
+
+    if (MAP_FAILED == lMap) {
+        std::cerr << "[ERROR] <TimerStatsReader::open> Failed to map " << pPath << " : " << std::strerror(errno) << std::endl;
+        return 255; /* ERROR */
+    }
+
+    TimerStatsPage const * const lPage = static_cast<TimerStatsPage const *>(lMap);
+
+    if ((TIMER_STATS_MAGIC != lPage->magic)
+        || (TIMER_STATS_VERSION != lPage->version)
+        || (sizeof(TimerStatsPage) != lPage->size))
+    {
+        std::cerr << "[ERROR] <TimerStatsReader::open> " << pPath << " has an unsupported layout" << std::endl;
+        munmap(lMap, sizeof(TimerStatsPage));
+        return 255; /* ERROR */
+    }
+
+    page = lPage;
+
+    return 0;
+}
+
+void TimerStatsReader::close() noexcept
+{
+    if (nullptr != page) {
+        munmap(const_cast<TimerStatsPage *>(page), sizeof(TimerStatsPage));
+        page = nullptr;
+    }
+}
+
+int TimerStatsReader::read(TimerStatsData &pData) const noexcept
+{
+    if (nullptr == page) {
+        std::cerr << "[ERROR] <TimerStatsReader::read> Not open !" << std::endl;
+        return 255; /* ERROR */
+    }
+
+    for (int i = 0; i < TIMER_STATS_READ_RETRIES; ++i) {
+        std::uint64_t const lBefore = page->sequence.load(std::memory_order_acquire);
+
+        if (0U != (lBefore & 1U)) {
+            // Being updated
+            continue;
+        }
+
+        std::memcpy(&pData, &page->data, sizeof(TimerStatsData));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (page->sequence.load(std::memory_order_relaxed) == lBefore) {
+            return 0;
+        }
+    }
+
+    std::cerr << "[ERROR] <TimerStatsReader::read> No consistent snapshot after " << TIMER_STATS_READ_RETRIES << " attempts" << std::endl;
+    return 255; /* ERROR */
+}
+
+bool TimerStatsReader::isOpen() const noexcept
+{
+    return nullptr != page;
+}
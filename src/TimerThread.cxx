@@ -6,81 +6,338 @@
 
 /* Includes -------------------------------------------- */
 #include "TimerThread.hxx"
+#include "TimerDomain.hxx"
 
 #include <cassert>
 #include <iostream>
+#include <algorithm>
 
 #include <cstring>
 
+#include <unistd.h>
+
+/* Worker identification ------------------------------- */
+// Engine whose worker is the calling thread, if any
+static thread_local TimerThread *sWorker = nullptr;
+
 /* TimerThread implementation -------------------------- */
 void TimerThread::timerThreadWorker()
 {
+    sWorker = this;
+
     ScopedLock lock(sync);
 
+    // Collected and claimed with the lock held, so a racing clearTimer
+    // either takes the timer out of the staging backend or finds it here
+    auto admit = [this](Submission &&submission) {
+                        bool needNotify = false;
+                        admitSubmission_impl(std::move(submission), *this, needNotify);
+                    };
+
     while (!done) {
-        if (queue.empty()) {
-            // Wait for done or work
-            wakeUp.wait(lock, [this] {
-                return done || !queue.empty();
-            });
+        // Merge the timers created by the last handlers
+        if (!pending.empty()) {
+            merge_impl();
+        }
+
+        // Let the clearTimer calls that waited for
+        // merged or claimed timers go first
+        while (0U < mergeWaiters) {
+            if (staged.posted()) {
+                staged.serve(admit);
+                merged.notify_all();
+            }
+
+            merged.wait(lock);
+        }
+
+        // Move the timers of the staging backends that
+        // are coming due into the ordering queues
+        if (staged.used()) {
+            staged.collect(lock, Clock::now(), admit);
+        }
+
+        auto now = Clock::now();
+
+        // Move the timers of the wheel that are
+        // coming due into the ordering queue
+        if (wheelCount > 0U) {
+            wheelAdvance_impl(now);
+        }
+
+        rebalance_impl();
+
+        Timer *head = head_impl();
+
+        if ((nullptr != head) && (now >= head->deadline())) {
+            dequeue_impl(*head);
+            dispatch_impl(lock, *head);
             continue;
         }
 
-        auto   queueHead = queue.begin();
-        Timer &timer     = *queueHead;
-        auto   now       = Clock::now();
-        if (now >= timer.next) {
-            queue.erase(queueHead);
+        if (!deferred.empty() && (now >= deferred.begin()->get().next)) {
+            // Deferrable timers don't wake the worker up before their
+            // deadline, but they fire when it is already awake
+            Timer &lazy = *(deferred.begin());
 
-            // Mark it as running to handle racing destroy
-            timer.running = true;
+            deferred.erase(deferred.begin());
+            queue.erase(lazy.queuePos);
 
-            // Call the handler outside the lock
-            lock.unlock();
-            timer.handler();
-            lock.lock();
-
-            if (timer.running) {
-                timer.running = false;
-
-                // If it is periodic, schedule a new one
-                if (timer.period.count() > 0) {
-                    timer.next = timer.next + timer.period;
-                    queue.emplace(timer);
-                } else {
-                    // Not rescheduling, destruct it
-                    active.erase(timer.id);
-                }
+            dispatch_impl(lock, lazy);
+            continue;
+        }
+
+        // Wait until the next timer is ready, the next slot of the
+        // wheels, or for done or work. The producers of the staging
+        // backends only see when the worker wakes up once published
+        sleepUntil = (nullptr != head) ? head->deadline() : Timestamp::max();
+
+        if (wheelCount > 0U) {
+            sleepUntil = std::min(sleepUntil.load(), wheelNext_impl());
+        }
+
+        if (staged.used()) {
+            sleepUntil = std::min(sleepUntil.load(), staged.next());
+        }
+
+        if (idle_impl()) {
+            if (Timestamp::max() != sleepUntil.load()) {
+                wakeUp.wait_until(lock, sleepUntil.load());
             } else {
-                // timer.running changed!
-                //
-                // Running was set to false, destroy was called
-                // for this Timer while the callback was in progress
-                // (this thread was not holding the lock during the callback)
-                // The thread trying to destroy this timer is waiting on
-                // a condition variable, so notify it
-                timer.waitCond->notify_all();
-
-                // The clearTimer call expects us to remove the instance
-                // when it detects that it is racing with its callback
-                active.erase(timer.id);
+                wakeUp.wait(lock);
+            }
+        }
+
+        sleepUntil = Timestamp::min();
+    }
+}
+
+// NOTE: called by the worker with the lock held, once it published
+// sleepUntil. This is the one condition for the worker to sleep: it
+// sleeps when nothing is left that it would not be notified about.
+// The threads changing what it covers do so with the lock held, and
+// notify, but the worker released the lock earlier in the iteration,
+// to run a handler, to wait for the merges or to collect the staging
+// backends, so it may have missed their notifications:
+// - done is set by the destructor
+// - mergeWaiters counts the clearTimer calls waiting for a merged or
+//   a claimed timer. A claim is only posted along with its waiter
+// The producers of the staging backends don't take the lock. They
+// read sleepUntil once their timer is in, and notify if the worker
+// would wake up too late to collect it, see stage_impl
+bool TimerThread::idle_impl() const
+{
+    return !done && (0U == mergeWaiters);
+}
+
+// NOTE: called by the worker with the lock held, for a Timer that
+// is due and was removed from the ordering queues. Returns with the
+// lock held, but releases it while the handler is running
+void TimerThread::dispatch_impl(ScopedLock &lock, Timer &timer)
+{
+    assert(lock.owns_lock());
+
+    // Lazily destroy a Timer cancelled through its flag
+    if (timer.cancelFlag && timer.cancelFlag->load(std::memory_order_acquire)) {
+        finished_impl(timer, true);
+        erase_impl(timer);
+        return;
+    }
+
+    // Mark it as running to handle racing destroy
+    timer.running = true;
+
+    // The label may change once we release the lock
+    const char *label    = timer.label;
+    bool const  rename   = (nullptr != label) && labelThreadName;
+    char        name[16] = {0};
+    Timestamp   started;
+
+    if (nullptr != label) {
+        started = Clock::now();
+    }
+
+    // Call the handler outside the lock
+    lock.unlock();
+
+    if (rename) {
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        pthread_setname_np(pthread_self(), std::string(label, strnlen(label, sizeof(name) - 1U)).c_str());
+    }
+
+    timer.handler();
+
+    if (rename) {
+        pthread_setname_np(pthread_self(), name);
+    }
+
+    // The period can't change while the Timer exists,
+    // so it can be read without the lock
+    Timestamp completed;
+    if ((timer.period.count() > 0) || (nullptr != label)) {
+        completed = Clock::now();
+    }
+
+    lock.lock();
+
+    if (nullptr != label) {
+        LabelStats &stats = labels[label];
+
+        ++stats.fires;
+        stats.nanoseconds += static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(completed - started).count());
+    }
+
+    // Detect deadline misses of periodic timers. Deferrable
+    // timers are expected to be late, so they are left out
+    if (timer.running
+        && (timer.period.count() > 0)
+        && !timer.deferrable()
+        && (completed > timer.next + timer.period))
+    {
+        deadlineMiss(lock, timer, completed);
+    }
+
+    if (timer.running) {
+        timer.running = false;
+
+        // If it is periodic, schedule a new one, unless
+        // upsertTimer replaced it while it was running
+        if ((timer.period.count() > 0) && !timer.detached) {
+            timer.next = timer.next + timer.period;
+
+            // The releases of a deferrable timer that went by
+            // while it was deferred are coalesced into this one
+            if (timer.deferrable() && (timer.next <= completed)) {
+                timer.next = timer.next + timer.period * ((completed - timer.next) / timer.period + 1);
+            }
+
+            enqueue_impl(timer);
+            ++periodicFireCount;
+
+            if (profiler) {
+                profiler->periodicFired();
             }
         } else {
-            // Wait until the timer is ready or a timer creation notifies
-            wakeUp.wait_until(lock, timer.next);
+            // Not rescheduling, destruct it
+            finished_impl(timer, false);
+            erase_impl(timer);
+        }
+    } else {
+        // timer.running changed!
+        //
+        // Running was set to false, destroy was called
+        // for this Timer while the callback was in progress
+        // (this thread was not holding the lock during the callback)
+        // The thread trying to destroy this timer is waiting on
+        // a condition variable, so notify it
+        timer.waitCond->notify_all();
+
+        // A cancelled periodic timer was recorded by destroy_impl
+        if (timer.period.count() <= 0) {
+            finished_impl(timer, false);
         }
+
+        // The clearTimer call expects us to remove the instance
+        // when it detects that it is racing with its callback
+        erase_impl(timer);
     }
 }
 
 TimerThread::TimerThread()
-    : nextId(no_timer + 1),
+    : TimerThread(LockPolicy::Blocking)
+{
+}
+
+TimerThread::TimerThread(LockPolicy lockPolicy)
+    : engine(this),
+    missCount(0U),
+    nextId(no_timer + 1),
+    pending(),
+    pendingSync(),
+    pendingLow(max_timer),
+    mergeWaiters(0U),
+    queue(),
+    profiler(),
+    createCount(0U),
+    fireCount(0U),
+    periodicFireCount(0U),
+    cancelCount(0U),
+    missTotal(0U),
+    statsTimer(no_timer),
+    statsUpdates(0U),
+    labels(),
+    labelThreadName(false),
+    backend(QueueBackend::Tree),
+    adaptive(false),
+    wheelAbove(0U),
+    treeBelow(0U),
+    wheelCancelRatio(1.0),
+    cancelRatio(0.0),
+    windowFires(0U),
+    windowCancels(0U),
+    lanes(),
+    laneCount(0U),
+    wheel(),
+    wheelCount(0U),
+    horizon(),
+    migrateSlot(0U),
+    sleepUntil(Timestamp::min()),
+    staged(TIMER_WHEEL_SLOTS, Duration(TIMER_WHEEL_RESOLUTION)),
+    combiner(),
+    sync(lockPolicy),
+    done(false)
+{
+}
+
+TimerThread::TimerThread(TimerDomain &domain)
+    : engine(domain.attach()),
+    missCount(0U),
+    nextId(no_timer + 1),
+    pending(),
+    pendingSync(),
+    pendingLow(max_timer),
+    mergeWaiters(0U),
     queue(),
+    profiler(),
+    createCount(0U),
+    fireCount(0U),
+    periodicFireCount(0U),
+    cancelCount(0U),
+    missTotal(0U),
+    statsTimer(no_timer),
+    statsUpdates(0U),
+    labels(),
+    labelThreadName(false),
+    backend(QueueBackend::Tree),
+    adaptive(false),
+    wheelAbove(0U),
+    treeBelow(0U),
+    wheelCancelRatio(1.0),
+    cancelRatio(0.0),
+    windowFires(0U),
+    windowCancels(0U),
+    lanes(),
+    laneCount(0U),
+    wheel(),
+    wheelCount(0U),
+    horizon(),
+    migrateSlot(0U),
+    sleepUntil(Timestamp::min()),
+    staged(TIMER_WHEEL_SLOTS, Duration(TIMER_WHEEL_RESOLUTION)),
+    combiner(),
     done(false)
 {
 }
 
 TimerThread::~TimerThread()
 {
+    if (engine != this) {
+        // Only destroy the timers of this front-end,
+        // the engine belongs to the TimerDomain
+        clear();
+        return;
+    }
+
     ScopedLock lock(sync);
 
     // The worker might not be running
@@ -114,144 +371,1472 @@ TimerThread::timer_id_t TimerThread::addTimer(time_us_t    msDelay,
                                                 time_us_t    msPeriod,
                                                 handler_type handler)
 {
-    ScopedLock lock(sync);
+    // Called from a handler: the worker is awake, and merges the
+    // timer once the handler returns, without locking nor notifying
+    if (sWorker == engine) {
+        return engine->pendingAdd_impl(*this, Duration(msDelay), Duration(msPeriod), std::move(handler));
+    }
 
-    // Start thread when first timer is requested
-    if (!worker.joinable()) {
-        worker = std::thread(&TimerThread::timerThreadWorker, this);
+    // Leave the timer in the staging backend without the lock,
+    // unless it is due too soon for it
+    if ((engine == this) && staged.accepts()) {
+        Submission submission{nextId.fetch_add(1U, std::memory_order_relaxed),
+                                Clock::now() + Duration(msDelay),
+                                Duration(msDelay),
+                                Duration(msPeriod),
+                                std::move(handler)};
+
+        if (stage_impl(submission)) {
+            return submission.id;
+        }
+
+        handler = std::move(submission.handler);
     }
 
-    // Assign an ID and insert it into function storage
-    auto id   = nextId++;
-    auto iter = active.emplace(id, Timer(id,
-                                            Clock::now() + Duration(msDelay),
-                                            Duration(msPeriod),
-                                            std::move(handler)));
+    // Let the thread holding the lock create the timer
+    if (engine->combiner.enabled()) {
+        if (Combiner::Record *record = engine->combiner.record()) {
+            Operation &operation = record->op;
 
-    // Insert a reference to the Timer into ordering queue
-    Queue::iterator place = queue.emplace(iter.first->second);
+            operation.owner   = this;
+            operation.add     = true;
+            operation.delay   = Duration(msDelay);
+            operation.period  = Duration(msPeriod);
+            operation.handler = std::move(handler);
 
-    // We need to notify the timer thread only if we inserted
-    // this timer into the front of the timer queue
-    bool needNotify = (place == queue.begin());
+            engine->combine_impl(*record);
+
+            return operation.id;
+        }
+    }
+
+    ScopedLock lock(engine->sync);
+    bool       needNotify = false;
+    timer_id_t id         = engine->create_impl(lock,
+                                                *this,
+                                                Duration(msDelay),
+                                                Duration(msPeriod),
+                                                Duration(0),
+                                                std::move(handler),
+                                                needNotify).id;
 
     lock.unlock();
 
     if (needNotify) {
-        wakeUp.notify_all();
+        engine->wakeUp.notify_all();
     }
 
     return id;
 }
 
-bool TimerThread::clearTimer(timer_id_t id)
+TimerThread::timer_id_t TimerThread::addCancellableTimer(time_us_t                               msDelay,
+                                                        time_us_t                               msPeriod,
+                                                        handler_type                            handler,
+                                                        std::shared_ptr<std::atomic<bool> const> cancelFlag)
 {
-    ScopedLock lock(sync);
-    auto       i = active.find(id);
+    ScopedLock lock(engine->sync);
+    bool       needNotify = false;
+    Timer     &timer      = engine->create_impl(lock,
+                                                *this,
+                                                Duration(msDelay),
+                                                Duration(msPeriod),
+                                                Duration(0),
+                                                std::move(handler),
+                                                needNotify);
+    timer_id_t id         = timer.id;
+
+    // The worker looks at the flag with the lock held
+    timer.cancelFlag = std::move(cancelFlag);
+
+    lock.unlock();
+
+    if (needNotify) {
+        engine->wakeUp.notify_all();
+    }
 
-    return destroy_impl(lock, i, true);
+    return id;
 }
 
-void TimerThread::clear()
+TimerThread::timer_id_t TimerThread::addDeferrableTimer(time_us_t    msDelay,
+                                                        time_us_t    msPeriod,
+                                                        time_us_t    msSlack,
+                                                        handler_type handler)
 {
-    ScopedLock lock(sync);
+    ScopedLock lock(engine->sync);
+    bool       needNotify = false;
+    timer_id_t id         = engine->create_impl(lock,
+                                                *this,
+                                                Duration(msDelay),
+                                                Duration(msPeriod),
+                                                Duration(msSlack > 0 ? msSlack : 0),
+                                                std::move(handler),
+                                                needNotify).id;
 
-    while (!active.empty()) {
-        destroy_impl(lock, active.begin(),
-                        queue.size() == 1);
+    lock.unlock();
+
+    if (needNotify) {
+        engine->wakeUp.notify_all();
     }
+
+    return id;
 }
 
-int TimerThread::setScheduling(const int &pPolicy, const int &pPriority)
+TimerThread::timer_id_t TimerThread::upsertTimer(timer_key_t  key,
+                                                    time_us_t    msDelay,
+                                                    time_us_t    msPeriod,
+                                                    handler_type handler,
+                                                    UpsertPolicy policy)
 {
-    sched_param sch_params;
-    int         res = 0;
+    TimerThread &e = *engine;
+    ScopedLock   lock(e.sync);
+    Timestamp    next = Clock::now() + Duration(msDelay);
+    auto         k    = keys.find(key);
 
-    sch_params.sched_priority = pPriority;
+    if (k != keys.end()) {
+        Timer &timer = e.active.find(k->second)->second;
 
-    res = pthread_setschedparam(worker.native_handle(), pPolicy, &sch_params);
-    if (res) {
-        std::cerr << "[ERROR] <TimerThread> Failed to set Thread scheduling : " << std::strerror(errno) << std::endl;
+        if (!timer.running) {
+            // The existing timer wins, leave it untouched
+            if (((UpsertPolicy::KeepEarliest == policy) && !(next < timer.next))
+                || ((UpsertPolicy::KeepLatest == policy) && !(next > timer.next)))
+            {
+                return timer.id;
+            }
+
+            // Move the existing timer, keeping its ID
+            e.dequeue_impl(timer);
+
+            timer.next    = next;
+            timer.delay   = Duration(msDelay);
+            timer.period  = Duration(msPeriod);
+            timer.handler = std::move(handler);
+
+            if (e.profiler) {
+                e.profiler->reset();
+            }
+
+            // We need to notify the timer thread only if we moved
+            // this timer into the front of the timer queue
+            bool needNotify = e.enqueue_impl(timer);
+
+            lock.unlock();
+
+            if (needNotify) {
+                e.wakeUp.notify_all();
+            }
+
+            return timer.id;
+        }
+
+        // The existing timer's handler is in progress, so its next
+        // release is not in the queue. Detach it from the key, the
+        // worker destroys it once the handler returns, and create a
+        // new timer for the key
+        timer.keyed    = false;
+        timer.detached = true;
+        keys.erase(k);
     }
 
-    return res;
+    bool       needNotify = false;
+    Timer     &timer      = e.create_impl(lock, *this, Duration(msDelay), Duration(msPeriod), Duration(0), std::move(handler), needNotify);
+    timer_id_t id         = timer.id;
+
+    keys.emplace(key, id);
+    timer.key   = key;
+    timer.keyed = true;
+
+    lock.unlock();
+
+    if (needNotify) {
+        e.wakeUp.notify_all();
+    }
+
+    return id;
 }
 
-int TimerThread::scheduling(int * const pPolicy, int * const pPriority) noexcept
+bool TimerThread::clearTimer(timer_id_t id)
 {
-    sched_param sch_params;
-    int         lPolicy = 0, res = 0;
+    // A timer of the staging backend is taken out without the lock
+    if ((engine == this) && staged.used()) {
+        Submission submission;
 
-    /* Checking arguments */
-    if (nullptr == pPolicy) {
-        std::cerr << "[ERROR] <TimerThread::scheduling> pPolicy = nullptr !" << std::endl;
-        return 255; /* ERROR */
-    } else if (nullptr == pPriority) {
-        std::cerr << "[ERROR] <TimerThread::scheduling> pPriority = nullptr !" << std::endl;
-        return 255; /* ERROR */
+        if (staged.take(id, submission)) {
+            return true;
+        }
     }
 
-    res = pthread_setschedparam(worker.native_handle(), lPolicy, &sch_params);
-    if (res) {
-        std::cerr << "[ERROR] <TimerThread> Failed to get Thread scheduling : " << std::strerror(errno) << std::endl;
-        *pPriority = 0; /* 0 not possible, indicates an error */
-    } else {
-        *pPriority = sch_params.sched_priority; /* Should be between 1 & 99 */
+    // Let the thread holding the lock destroy the timer
+    if ((sWorker != engine) && engine->combiner.enabled()) {
+        if (Combiner::Record *record = engine->combiner.record()) {
+            Operation &operation = record->op;
+
+            operation.owner = this;
+            operation.add   = false;
+            operation.id    = id;
+
+            if (engine->combine_impl(*record)) {
+                return operation.cleared;
+            }
+        }
     }
 
-    return res;
+    ScopedLock lock(engine->sync);
+
+    return engine->destroy_impl(lock, findMerged_impl(lock, id), true);
 }
 
-std::size_t TimerThread::size() const noexcept
+bool TimerThread::clearKey(timer_key_t key)
 {
-    ScopedLock lock(sync);
+    ScopedLock lock(engine->sync);
+    auto       k = keys.find(key);
+
+    if (k == keys.end()) {
+        return false;
+    }
 
-    return active.size();
+    return engine->destroy_impl(lock, engine->active.find(k->second), true);
 }
 
-bool TimerThread::empty() const noexcept
+TimerThread::timer_id_t TimerThread::keyedTimer(timer_key_t key) const noexcept
 {
-    ScopedLock lock(sync);
+    ScopedLock lock(engine->sync);
+    auto       k = keys.find(key);
 
-    return active.empty();
+    return (k == keys.end()) ? no_timer : k->second;
 }
 
-// NOTE: if notify is true, returns with lock unlocked
-bool TimerThread::destroy_impl(ScopedLock        &lock,
-                                TimerMap::iterator i,
-                                bool               notify)
+bool TimerThread::setMissHandler(timer_id_t        id,
+                                    miss_handler_type handler,
+                                    MissPolicy        policy)
 {
-    assert(lock.owns_lock());
+    ScopedLock lock(engine->sync);
+    auto       i = findMerged_impl(lock, id);
 
-    if (i == active.end()) {
+    if (i == engine->active.end()) {
         return false;
     }
 
-    Timer &timer = i->second;
+    i->second.missHandler = std::move(handler);
+    i->second.missPolicy  = policy;
 
-    if (timer.running) {
-        // A callback is in progress for this Timer,
-        // so flag it for deletion in the worker
-        timer.running = false;
+    return true;
+}
 
-        // Assign a condition variable to this timer
-        timer.waitCond.reset(new ConditionVar);
+std::uint64_t TimerThread::deadlineMisses(timer_id_t id) const noexcept
+{
+    ScopedLock lock(engine->sync);
+    auto       i = find_impl(id);
 
-        // Block until the callback is finished
-        timer.waitCond->wait(lock);
-    } else {
-        queue.erase(timer);
-        active.erase(i);
+    return (i == engine->active.end()) ? 0U : i->second.misses;
+}
 
-        if (notify) {
-            lock.unlock();
-            wakeUp.notify_all();
+std::uint64_t TimerThread::deadlineMisses() const noexcept
+{
+    ScopedLock lock(engine->sync);
+
+    return missCount;
+}
+
+void TimerThread::clear()
+{
+    TimerThread &e = *engine;
+    ScopedLock   lock(e.sync);
+
+    if (&e == this) {
+        // All but the timer publishing the stats
+        while (0U < activeSize_impl()) {
+            auto i = active.begin();
+
+            if (i->first == statsTimer) {
+                ++i;
+            }
+
+            destroy_impl(lock, i, false);
         }
+
+        staged.clear();
+    } else {
+        // Timers of other front-ends stay in the engine
+        while (!owned.empty()) {
+            e.destroy_impl(lock, e.active.find(*owned.begin()), false);
+        }
+    }
+
+    // Created by a running handler, they would be merged later
+    pendingClear_impl();
+
+    lock.unlock();
+
+    // The worker may be waiting for a destroyed timer
+    e.wakeUp.notify_all();
+}
+
+void TimerThread::enableProfiler(bool enable)
+{
+    ScopedLock lock(engine->sync);
+
+    if (!enable) {
+        engine->profiler.reset();
+    } else if (!engine->profiler) {
+        engine->profiler.reset(new TimerProfiler);
+    }
+}
+
+bool TimerThread::profile(TimerProfiler &pProfiler) const
+{
+    ScopedLock lock(engine->sync);
+
+    if (!engine->profiler) {
+        return false;
+    }
+
+    pProfiler = *(engine->profiler);
+
+    return true;
+}
+
+std::string TimerThread::profileReport() const
+{
+    TimerProfiler lProfiler;
+
+    // Build the report outside the lock
+    if (!profile(lProfiler)) {
+        return std::string();
+    }
+
+    return lProfiler.report();
+}
+
+bool TimerThread::setLabel(timer_id_t id, const char *label)
+{
+    ScopedLock lock(engine->sync);
+    auto       i = findMerged_impl(lock, id);
+
+    if (i == engine->active.end()) {
+        return false;
     }
 
+    i->second.label = label;
+
     return true;
 }
 
+const char *TimerThread::label(timer_id_t id) const noexcept
+{
+    ScopedLock lock(engine->sync);
+    auto       i = find_impl(id);
+
+    return (i == engine->active.end()) ? nullptr : i->second.label;
+}
+
+std::vector<std::pair<const char *, TimerThread::LabelStats>> TimerThread::labelStats() const
+{
+    ScopedLock lock(engine->sync);
+
+    return std::vector<std::pair<const char *, LabelStats>>(engine->labels.begin(), engine->labels.end());
+}
+
+void TimerThread::setLabelThreadName(bool enable)
+{
+    ScopedLock lock(engine->sync);
+
+    engine->labelThreadName = enable;
+}
+
+int TimerThread::publishStats(const char * const pPath, time_us_t msPeriod)
+{
+    if (0 >= msPeriod) {
+        std::cerr << "[ERROR] <TimerThread::publishStats> msPeriod must be positive !" << std::endl;
+        return 255; /* ERROR */
+    }
+
+    TimerThread &e = *engine;
+
+    // The previous writer is closed before the file is truncated
+    std::lock_guard<std::mutex> statsLock(e.statsSync);
+
+    e.unpublish_impl();
+
+    std::shared_ptr<TimerStatsWriter> writer = std::make_shared<TimerStatsWriter>();
+
+    if (0 != writer->open(pPath)) {
+        return 255; /* ERROR */
+    }
+
+    std::uint64_t const pid = static_cast<std::uint64_t>(getpid());
+
+    e.publish_impl(*writer, pid);
+
+    // The timer owns its writer, which is closed with it. It is
+    // created in the tree, where size() and clear() can leave it out
+    ScopedLock lock(e.sync);
+    bool       needNotify = false;
+    Timer     &timer      = e.create_impl(lock,
+                                            e,
+                                            Duration(msPeriod),
+                                            Duration(msPeriod),
+                                            Duration(0),
+                                            [&e, writer, pid]() {
+                                                e.publish_impl(*writer, pid);
+                                            },
+                                            needNotify);
+
+    timer.label  = "TimerThread.stats";
+    e.statsTimer = timer.id;
+
+    lock.unlock();
+
+    if (needNotify) {
+        e.wakeUp.notify_all();
+    }
+
+    return 0;
+}
+
+void TimerThread::unpublishStats()
+{
+    TimerThread                &e = *engine;
+    std::lock_guard<std::mutex> statsLock(e.statsSync);
+
+    e.unpublish_impl();
+}
+
+void TimerThread::setQueueBackend(QueueBackend backend)
+{
+    ScopedLock lock(engine->sync);
+
+    engine->adaptive = false;
+    engine->backend  = backend;
+
+    // The timers already staged are collected when they come due
+    switch (backend) {
+        case QueueBackend::ConcurrentWheel:
+            engine->staged.select(StagedBackend::ConcurrentWheel);
+            break;
+        case QueueBackend::SkipList:
+            engine->staged.select(StagedBackend::SkipList);
+            break;
+        case QueueBackend::MultiQueue:
+            engine->staged.select(StagedBackend::MultiQueue);
+            break;
+        case QueueBackend::LocalHeaps:
+            engine->staged.select(StagedBackend::LocalHeaps);
+            break;
+        default:
+            engine->staged.select(StagedBackend::None);
+            break;
+    }
+
+    // The producers of the staging backends don't start the worker
+    if (engine->staged.accepts() && !engine->worker.joinable()) {
+        engine->worker = std::thread(&TimerThread::timerThreadWorker, engine);
+    }
+
+    // The pending timers are migrated along with the next operations
+    engine->rebalance_impl();
+}
+
+void TimerThread::setRelaxation(std::size_t choices)
+{
+    ScopedLock lock(engine->sync);
+
+    engine->staged.setRelaxation(choices);
+}
+
+void TimerThread::setFlatCombining(bool enabled)
+{
+    ScopedLock lock(engine->sync);
+
+    engine->combiner.enable(enabled);
+}
+
+void TimerThread::setAdaptiveBackend(std::size_t wheelAbove,
+                                        std::size_t treeBelow,
+                                        double      cancelRatio)
+{
+    ScopedLock lock(engine->sync);
+
+    engine->adaptive         = true;
+    engine->wheelAbove       = wheelAbove;
+    engine->treeBelow        = std::min(treeBelow, wheelAbove);
+    engine->wheelCancelRatio = cancelRatio;
+    engine->staged.select(StagedBackend::None);
+
+    engine->rebalance_impl();
+}
+
+TimerThread::QueueBackend TimerThread::queueBackend() const noexcept
+{
+    ScopedLock lock(engine->sync);
+
+    return engine->backend;
+}
+
+int TimerThread::setScheduling(const int &pPolicy, const int &pPriority)
+{
+    sched_param sch_params;
+    int         res = 0;
+
+    sch_params.sched_priority = pPriority;
+
+    res = pthread_setschedparam(engine->worker.native_handle(), pPolicy, &sch_params);
+    if (res) {
+        std::cerr << "[ERROR] <TimerThread> Failed to set Thread scheduling : " << std::strerror(errno) << std::endl;
+    }
+
+    return res;
+}
+
+int TimerThread::scheduling(int * const pPolicy, int * const pPriority) noexcept
+{
+    sched_param sch_params;
+    int         lPolicy = 0, res = 0;
+
+    /* Checking arguments */
+    if (nullptr == pPolicy) {
+        std::cerr << "[ERROR] <TimerThread::scheduling> pPolicy = nullptr !" << std::endl;
+        return 255; /* ERROR */
+    } else if (nullptr == pPriority) {
+        std::cerr << "[ERROR] <TimerThread::scheduling> pPriority = nullptr !" << std::endl;
+        return 255; /* ERROR */
+    }
+
+    res = pthread_setschedparam(engine->worker.native_handle(), lPolicy, &sch_params);
+    if (res) {
+        std::cerr << "[ERROR] <TimerThread> Failed to get Thread scheduling : " << std::strerror(errno) << std::endl;
+        *pPriority = 0; /* 0 not possible, indicates an error */
+    } else {
+        *pPriority = sch_params.sched_priority; /* Should be between 1 & 99 */
+    }
+
+    return res;
+}
+
+std::size_t TimerThread::size() const noexcept
+{
+    ScopedLock lock(engine->sync);
+
+    if (engine != this) {
+        return owned.size() + pendingSize_impl();
+    }
+
+    return activeSize_impl() + staged.size() + pendingSize_impl();
+}
+
+bool TimerThread::empty() const noexcept
+{
+    ScopedLock lock(engine->sync);
+
+    if (engine != this) {
+        return owned.empty() && (0U == pendingSize_impl());
+    }
+
+    return (0U == activeSize_impl()) && (0U == staged.size()) && (0U == pendingSize_impl());
+}
+
+// NOTE: returns with the lock held, the caller must notify
+// the worker if needNotify is set once it released the lock
+TimerThread::Timer &TimerThread::create_impl(ScopedLock  &lock,
+                                                TimerThread &owner,
+                                                Duration     delay,
+                                                Duration     period,
+                                                Duration     slack,
+                                                handler_type handler,
+                                                bool        &needNotify)
+{
+    assert(lock.owns_lock());
+
+    Timestamp const now = Clock::now();
+
+    // Start thread when first timer is requested
+    if (!worker.joinable()) {
+        worker = std::thread(&TimerThread::timerThreadWorker, this);
+    }
+
+    // Assign an ID and insert it into function storage
+    Timer timer(nextId.fetch_add(1U, std::memory_order_relaxed),
+                owner,
+                now + delay,
+                period,
+                std::move(handler));
+
+    timer.delay = delay;
+    timer.slack = slack;
+
+    return admit_impl(std::move(timer), needNotify);
+}
+
+// Stores a new Timer and inserts it into the ordering queues.
+// needNotify is set if the worker must be notified
+TimerThread::Timer &TimerThread::admit_impl(Timer &&timer, bool &needNotify)
+{
+    timer_id_t const id   = timer.id;
+    auto             iter = active.emplace(id, std::move(timer));
+    Timer           &t    = iter.first->second;
+
+    ++createCount;
+
+    if (profiler) {
+        t.created = t.next - t.delay;
+        profiler->created(t.delay.count(), t.period.count(), active.size());
+    }
+
+    // Front-ends of a TimerDomain keep track of their timers
+    if (t.owner != this) {
+        t.owner->owned.insert(id);
+    }
+
+    // We need to notify the timer thread only if we inserted
+    // this timer into the front of the timer queue
+    needNotify = enqueue_impl(t);
+
+    rebalance_impl();
+
+    return t;
+}
+
+// NOTE: called by the worker, from a handler, without the lock.
+// The Timer is stored in the worker's pending list, and merged
+// into the queues once the handler returns
+TimerThread::timer_id_t TimerThread::pendingAdd_impl(TimerThread &owner,
+                                                        Duration     delay,
+                                                        Duration     period,
+                                                        handler_type handler)
+{
+    timer_id_t const id = nextId.fetch_add(1U, std::memory_order_relaxed);
+    PendingLock      lock(pendingSync);
+
+    pending.emplace_back(id, owner, Clock::now() + delay, period, std::move(handler));
+    pending.back().delay = delay;
+
+    if (1U == pending.size()) {
+        pendingLow.store(id, std::memory_order_release);
+    }
+
+    return id;
+}
+
+// NOTE: called by the worker with the lock held
+void TimerThread::merge_impl()
+{
+    PendingLock lock(pendingSync);
+    bool        needNotify = false;
+
+    // The worker is awake, so it does not need a notification
+    for (Timer &timer : pending) {
+        admit_impl(std::move(timer), needNotify);
+    }
+
+    pending.clear();
+    pendingLow.store(max_timer, std::memory_order_release);
+
+    if (0U < mergeWaiters) {
+        merged.notify_all();
+    }
+}
+
+// NOTE: called with the lock held. Whether a timer of this
+// front-end is pending, waiting for its handler to return
+bool TimerThread::pendingHas_impl(timer_id_t id) const
+{
+    TimerThread &e = *engine;
+    PendingLock  lock(e.pendingSync);
+
+    return std::any_of(e.pending.begin(), e.pending.end(),
+                        [this, id](Timer const &timer) {
+                            return (timer.id == id) && (timer.owner == this);
+                        });
+}
+
+// NOTE: called with the lock held
+std::size_t TimerThread::pendingSize_impl() const
+{
+    TimerThread &e = *engine;
+    PendingLock  lock(e.pendingSync);
+
+    if (&e == this) {
+        return e.pending.size();
+    }
+
+    return static_cast<std::size_t>(std::count_if(e.pending.begin(), e.pending.end(),
+                                                    [this](Timer const &timer) {
+                                                        return timer.owner == this;
+                                                    }));
+}
+
+// NOTE: called with the lock held. Drops the pending timers of this
+// front-end, so that they are not merged once the handler returns
+void TimerThread::pendingClear_impl()
+{
+    TimerThread &e = *engine;
+    PendingLock  lock(e.pendingSync);
+
+    std::vector<Timer> kept;
+    timer_id_t         low = max_timer;
+
+    // Timers are only move constructible
+    for (Timer &timer : e.pending) {
+        if ((&e != this) && (timer.owner != this)) {
+            low = std::min(low, timer.id);
+            kept.push_back(std::move(timer));
+        }
+    }
+
+    e.pending.swap(kept);
+
+    e.pendingLow.store(low, std::memory_order_release);
+}
+
+// Reserves the ID of a timer that a TimerBatch submits later
+TimerThread::timer_id_t TimerThread::reserve_impl() noexcept
+{
+    return engine->nextId.fetch_add(1U, std::memory_order_relaxed);
+}
+
+// Publishes the operations buffered by a TimerBatch under a
+// single lock. The clears only remove timers, so they do not
+// need to wake the worker up
+void TimerThread::submit_impl(std::vector<Submission>       &adds,
+                                std::vector<timer_id_t> const &clears)
+{
+    TimerThread &e = *engine;
+    ScopedLock   lock(e.sync);
+    bool         needNotify = false;
+
+    if (!adds.empty() && !e.worker.joinable()) {
+        e.worker = std::thread(&TimerThread::timerThreadWorker, &e);
+    }
+
+    for (Submission &submission : adds) {
+        bool lNotify = false;
+
+        e.admitSubmission_impl(std::move(submission), *this, lNotify);
+        needNotify = needNotify || lNotify;
+    }
+
+    for (timer_id_t const &id : clears) {
+        e.destroy_impl(lock, findMerged_impl(lock, id), false);
+    }
+
+    lock.unlock();
+
+    if (needNotify) {
+        e.wakeUp.notify_all();
+    }
+}
+
+// Stores the Timer of a Submission, see admit_impl
+TimerThread::Timer &TimerThread::admitSubmission_impl(Submission &&submission,
+                                                        TimerThread &owner,
+                                                        bool        &needNotify)
+{
+    Timer timer(submission.id,
+                owner,
+                submission.next,
+                submission.period,
+                std::move(submission.handler));
+
+    timer.delay = submission.delay;
+
+    return admit_impl(std::move(timer), needNotify);
+}
+
+// NOTE: called without the lock. Leaves the Timer of a Submission in
+// the staging backend, and notifies the worker if it wakes up too late
+// to collect it. Returns false, leaving the Submission untouched, if
+// it is due too soon for the staging backend
+bool TimerThread::stage_impl(Submission &submission)
+{
+    Timestamp collected;
+
+    if (!staged.insert(submission, collected)) {
+        return false;
+    }
+
+    // Either the worker sees the new timer before it sleeps,
+    // or we see when it sleeps until, see idle_impl
+    if (collected < sleepUntil.load()) {
+        ScopedLock lock(sync);
+        wakeUp.notify_all();
+    }
+
+    return true;
+}
+
+// NOTE: called with the lock held. Moves a timer of the LocalHeaps
+// backend created by another thread into the ordering queues. Only
+// the worker takes it out of the heap of its producer, so the other
+// threads post the ID and wait until it served them. The worker only
+// pops under the lock, so an ID missing from the heaps stays missing,
+// and returns without waiting for the worker
+void TimerThread::claim_impl(ScopedLock &lock, timer_id_t id)
+{
+    assert(lock.owns_lock());
+
+    if (!staged.claimable(id)) {
+        return;
+    }
+
+    if (sWorker == this) {
+        Submission submission;
+        bool       needNotify = false;
+
+        if (staged.claim(id, submission)) {
+            admitSubmission_impl(std::move(submission), *this, needNotify);
+        }
+
+        return;
+    }
+
+    std::uint64_t const round = staged.round();
+
+    staged.post(id);
+    ++mergeWaiters;
+
+    // Wherever the worker waits
+    wakeUp.notify_all();
+    merged.notify_all();
+
+    while (round == staged.round()) {
+        merged.wait(lock);
+    }
+
+    // The worker waits for the last one
+    if (0U == --mergeWaiters) {
+        merged.notify_all();
+    }
+}
+
+// NOTE: called without the lock. Posts the operation of the calling
+// thread, and returns once it is applied, by a thread holding the
+// lock or by this one once it gets the lock. Returns false if it was
+// sent back, to be retried with the lock
+bool TimerThread::combine_impl(Combiner::Record &record)
+{
+    auto combine = [this]() {
+                        ScopedLock lock(sync, std::adopt_lock);
+                        bool       needNotify = false;
+
+                        combiner.apply([this, &lock, &needNotify](Operation &operation) {
+                                            return apply_impl(lock, operation, needNotify);
+                                        });
+
+                        lock.unlock();
+
+                        if (needNotify) {
+                            wakeUp.notify_all();
+                        }
+                    };
+
+    return Combiner::State::Done == combiner.post(record, sync, combine);
+}
+
+// NOTE: called with the lock held. Applies a posted operation, and
+// sets needNotify if the worker must be notified. The combiner never
+// waits, so a clearTimer that would wait for a handler, or for the
+// worker, is sent back by returning false
+bool TimerThread::apply_impl(ScopedLock &lock, Operation &operation, bool &needNotify)
+{
+    assert(lock.owns_lock());
+
+    if (operation.add) {
+        bool lNotify = false;
+
+        operation.id = create_impl(lock,
+                                    *operation.owner,
+                                    operation.delay,
+                                    operation.period,
+                                    Duration(0),
+                                    std::move(operation.handler),
+                                    lNotify).id;
+        needNotify   = needNotify || lNotify;
+
+        return true;
+    }
+
+    auto i = operation.owner->find_impl(operation.id);
+
+    if ((i == active.end()) || i->second.running) {
+        return false;
+    }
+
+    operation.cleared = destroy_impl(lock, i, false);
+
+    return true;
+}
+
+// Inserts the Timer into the timing wheel or the ordering queues.
+// Returns true if the worker must be notified, because the Timer is
+// the new front of the queue or is due before the worker wakes up
+bool TimerThread::enqueue_impl(Timer &timer)
+{
+    // The Wheel backend takes the timers of the lanes too, it was
+    // selected for them. The timers already in a lane stay there
+    if ((QueueBackend::Wheel == backend) ? wheelInsert_impl(timer) : laneInsert_impl(timer))
+    {
+        return timer.deadline() < sleepUntil.load();
+    }
+
+    Queue::iterator place = queue.emplace(timer);
+
+    timer.queuePos = place;
+
+    // Deferrable timers are also sorted by their
+    // next release, to fire them early
+    if (timer.deferrable()) {
+        timer.deferredPos = deferred.emplace(timer);
+    }
+
+    return place == queue.begin();
+}
+
+// Removes the Timer from the timing wheel or the ordering queues
+void TimerThread::dequeue_impl(Timer &timer)
+{
+    if (timer.wheeled) {
+        wheelRemove_impl(timer);
+        return;
+    }
+
+    if (0 <= timer.lane) {
+        laneRemove_impl(timer);
+        return;
+    }
+
+    queue.erase(timer.queuePos);
+
+    if (timer.deferrable()) {
+        deferred.erase(timer.deferredPos);
+    }
+}
+
+// Removes a Timer that is no longer in the ordering queue
+void TimerThread::erase_impl(Timer &timer)
+{
+    TimerThread &owner = *(timer.owner);
+
+    if (timer.keyed) {
+        owner.keys.erase(timer.key);
+    }
+
+    if (&owner != this) {
+        owner.owned.erase(timer.id);
+    }
+
+    active.erase(timer.id);
+}
+
+// Finds a Timer of this front-end in its engine
+TimerThread::TimerMap::iterator TimerThread::find_impl(timer_id_t id) const
+{
+    // From a handler, the timers it created are merged
+    // first, so they can be found
+    if ((sWorker == engine) && !engine->pending.empty()) {
+        engine->merge_impl();
+    }
+
+    auto i = engine->active.find(id);
+
+    // The timers of other front-ends are out of reach
+    if ((i != engine->active.end()) && (i->second.owner != this)) {
+        return engine->active.end();
+    }
+
+    return i;
+}
+
+// Like find_impl, but a timer created by the handler that is
+// running is waited for, until the worker merges it once it returns
+TimerThread::TimerMap::iterator TimerThread::findMerged_impl(ScopedLock &lock, timer_id_t id) const
+{
+    assert(lock.owns_lock());
+
+    TimerThread &e = *engine;
+    auto         i = find_impl(id);
+
+    while ((i == e.active.end())
+            && (id >= e.pendingLow.load(std::memory_order_acquire))
+            && pendingHas_impl(id))
+    {
+        ++e.mergeWaiters;
+        e.merged.wait(lock);
+
+        // The worker waits for the last one
+        if (0U == --e.mergeWaiters) {
+            e.merged.notify_all();
+        }
+
+        i = find_impl(id);
+    }
+
+    // Move a timer of the staging backend into the queues
+    if ((i == e.active.end()) && (&e == this) && staged.used()) {
+        Submission submission;
+        bool       needNotify = false;
+
+        if (e.staged.take(id, submission)) {
+            i = e.active.find(e.admitSubmission_impl(std::move(submission), e, needNotify).id);
+        } else {
+            e.claim_impl(lock, id);
+            i = find_impl(id);
+        }
+    }
+
+    return i;
+}
+
+// NOTE: if notify is true, returns with lock unlocked
+bool TimerThread::destroy_impl(ScopedLock        &lock,
+                                TimerMap::iterator i,
+                                bool               notify)
+{
+    assert(lock.owns_lock());
+
+    if (i == active.end()) {
+        return false;
+    }
+
+    Timer &timer = i->second;
+
+    if (timer.running) {
+        // A callback is in progress for this Timer,
+        // so flag it for deletion in the worker
+        timer.running = false;
+
+        // A one-shot timer has fired already, the worker records it
+        if (timer.period.count() > 0) {
+            finished_impl(timer, true);
+        }
+
+        // Assign a condition variable to this timer
+        timer.waitCond.reset(new ConditionVar);
+
+        // Block until the callback is finished
+        timer.waitCond->wait(lock);
+    } else {
+        dequeue_impl(timer);
+
+        finished_impl(timer, true);
+        erase_impl(timer);
+        rebalance_impl();
+
+        if (notify) {
+            lock.unlock();
+            wakeUp.notify_all();
+        }
+    }
+
+    return true;
+}
+
+// NOTE: called by the worker with the lock held, for a running
+// periodic timer that completed after its next release.
+// Returns with the lock held, but releases it while the miss
+// handler is running.
+void TimerThread::deadlineMiss(ScopedLock &lock,
+                                Timer      &timer,
+                                Timestamp   completed)
+{
+    assert(lock.owns_lock());
+
+    ++timer.misses;
+    ++(timer.owner->missCount);
+    ++missTotal;
+
+    // How late the handler completed relative to the missed release
+    auto lateness = std::chrono::duration_cast<Duration>(completed - (timer.next + timer.period));
+
+    if (MissPolicy::Shed == timer.missPolicy) {
+        // Skip every release that is already in the past, the
+        // worker adds the last period when rescheduling the timer
+        timer.next = timer.next + timer.period * ((completed - timer.next) / timer.period);
+    }
+
+    if (timer.missHandler) {
+        // The handler may be replaced by setMissHandler once we
+        // release the lock, so call a copy of it. Misses should be
+        // rare, which makes the copy acceptable.
+        // The timer stays flagged as running, so a racing destroy
+        // is detected by the worker when this returns
+        miss_handler_type handler = timer.missHandler;
+
+        lock.unlock();
+        handler(timer.id, lateness.count());
+        lock.lock();
+    }
+}
+
+// Records the end of a Timer's life in the cancel ratio, and in
+// the profile if profiling was enabled when the Timer was created
+void TimerThread::finished_impl(Timer const &timer, bool cancelled)
+{
+    if (cancelled) {
+        ++cancelCount;
+        ++windowCancels;
+    } else {
+        ++fireCount;
+        ++windowFires;
+    }
+
+    if ((windowFires + windowCancels) >= TIMER_BACKEND_WINDOW) {
+        cancelRatio   = static_cast<double>(windowCancels) / static_cast<double>(windowFires + windowCancels);
+        windowFires   = 0U;
+        windowCancels = 0U;
+    }
+
+    if (!profiler || (Timestamp() == timer.created)) {
+        return;
+    }
+
+    time_us_t const lifetime = std::chrono::duration_cast<Duration>(Clock::now() - timer.created).count();
+
+    if (cancelled) {
+        profiler->cancelled(lifetime);
+    } else {
+        profiler->fired(lifetime);
+    }
+}
+
+// Appends a Timer to the FIFO lane of its duration: its delay, or
+// its period if it is periodic. A lane is assigned to the duration
+// if there is none and one is free. Returns false if the Timer
+// belongs elsewhere, because it is deferrable, no lane is free, or
+// it is due before the last Timer of the lane
+bool TimerThread::laneInsert_impl(Timer &timer)
+{
+    if (timer.deferrable()) {
+        return false;
+    }
+
+    Duration const duration = (timer.period.count() > 0) ? timer.period : timer.delay;
+    Lane          *lane     = nullptr;
+    Lane          *free     = nullptr;
+
+    for (Lane &l : lanes) {
+        if ((nullptr != l.tail) && (l.duration == duration)) {
+            lane = &l;
+            break;
+        }
+
+        if ((nullptr == free) && (nullptr == l.tail)) {
+            free = &l;
+        }
+    }
+
+    if (nullptr == lane) {
+        if (nullptr == free) {
+            return false;
+        }
+
+        lane           = free;
+        lane->duration = duration;
+        ++laneCount;
+    } else if (timer.deadline() < lane->tail->deadline()) {
+        // Deadlines of a lane must not decrease
+        return false;
+    }
+
+    timer.lane     = static_cast<int>(lane - lanes.data());
+    timer.lanePrev = lane->tail;
+    timer.laneNext = nullptr;
+
+    if (nullptr != lane->tail) {
+        lane->tail->laneNext = &timer;
+    } else {
+        lane->head = &timer;
+    }
+
+    lane->tail = &timer;
+
+    return true;
+}
+
+// Removes a Timer from its lane, which is released once empty
+void TimerThread::laneRemove_impl(Timer &timer)
+{
+    Lane &lane = lanes[static_cast<std::size_t>(timer.lane)];
+
+    if (nullptr != timer.lanePrev) {
+        timer.lanePrev->laneNext = timer.laneNext;
+    } else {
+        lane.head = timer.laneNext;
+    }
+
+    if (nullptr != timer.laneNext) {
+        timer.laneNext->lanePrev = timer.lanePrev;
+    } else {
+        lane.tail = timer.lanePrev;
+    }
+
+    if (nullptr == lane.tail) {
+        --laneCount;
+    }
+
+    timer.lanePrev = nullptr;
+    timer.laneNext = nullptr;
+    timer.lane     = -1;
+}
+
+// Earliest Timer among the front of the ordering queue
+// and the heads of the lanes, nullptr if there is none
+TimerThread::Timer *TimerThread::head_impl()
+{
+    Timer *head = queue.empty() ? nullptr : &(queue.begin()->get());
+
+    if (0U == laneCount) {
+        return head;
+    }
+
+    for (Lane &lane : lanes) {
+        if ((nullptr != lane.head)
+            && ((nullptr == head) || (lane.head->deadline() < head->deadline())))
+        {
+            head = lane.head;
+        }
+    }
+
+    return head;
+}
+
+// Tick of the timing wheel a point in time falls in
+template<typename T>
+static inline std::int64_t wheelTick(T const &t) noexcept
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count() / TIMER_WHEEL_RESOLUTION;
+}
+
+// Inserts a Timer into the timing wheel, unless it is deferrable or
+// due before the end of the slot the worker drains next. Returns
+// false if it belongs in the ordering queues
+bool TimerThread::wheelInsert_impl(Timer &timer)
+{
+    if (timer.deferrable()) {
+        return false;
+    }
+
+    if (0U == wheelCount) {
+        // Allocated on first use, and the
+        // horizon follows time while empty
+        if (wheel.empty()) {
+            wheel.assign(TIMER_WHEEL_SLOTS, nullptr);
+        }
+
+        horizon = Timestamp(Duration(wheelTick(Clock::now()) * TIMER_WHEEL_RESOLUTION));
+    }
+
+    if (timer.deadline() < horizon + Duration(TIMER_WHEEL_RESOLUTION)) {
+        return false;
+    }
+
+    Timer *&slot = wheel[static_cast<std::size_t>(wheelTick(timer.deadline()) % TIMER_WHEEL_SLOTS)];
+
+    timer.wheelPrev = nullptr;
+    timer.wheelNext = slot;
+
+    if (nullptr != slot) {
+        slot->wheelPrev = &timer;
+    }
+
+    slot          = &timer;
+    timer.wheeled = true;
+    ++wheelCount;
+
+    return true;
+}
+
+// Removes a Timer from the timing wheel
+void TimerThread::wheelRemove_impl(Timer &timer)
+{
+    if (nullptr != timer.wheelPrev) {
+        timer.wheelPrev->wheelNext = timer.wheelNext;
+    } else {
+        wheel[static_cast<std::size_t>(wheelTick(timer.deadline()) % TIMER_WHEEL_SLOTS)] = timer.wheelNext;
+    }
+
+    if (nullptr != timer.wheelNext) {
+        timer.wheelNext->wheelPrev = timer.wheelPrev;
+    }
+
+    timer.wheelPrev = nullptr;
+    timer.wheelNext = nullptr;
+    timer.wheeled   = false;
+    --wheelCount;
+}
+
+// Moves the Timers of the wheel slots the horizon went past
+// into the ordering queue. The Timers of later rounds stay
+void TimerThread::wheelAdvance_impl(Timestamp now)
+{
+    Duration const resolution(TIMER_WHEEL_RESOLUTION);
+
+    while ((wheelCount > 0U) && (horizon <= now)) {
+        Timestamp const end   = horizon + resolution;
+        Timer          *timer = wheel[static_cast<std::size_t>(wheelTick(horizon) % TIMER_WHEEL_SLOTS)];
+
+        while (nullptr != timer) {
+            Timer *next = timer->wheelNext;
+
+            if (timer->deadline() < end) {
+                wheelRemove_impl(*timer);
+                timer->queuePos = queue.emplace(*timer);
+            }
+
+            timer = next;
+        }
+
+        horizon = end;
+    }
+}
+
+// Start of the next slot of the wheel holding Timers
+TimerThread::Timestamp TimerThread::wheelNext_impl() const
+{
+    std::int64_t const tick = wheelTick(horizon);
+
+    for (std::int64_t i = 0; i < TIMER_WHEEL_SLOTS; ++i) {
+        if (nullptr != wheel[static_cast<std::size_t>((tick + i) % TIMER_WHEEL_SLOTS)]) {
+            return horizon + Duration(i * TIMER_WHEEL_RESOLUTION);
+        }
+    }
+
+    return Timestamp::max();
+}
+
+// Selects the backend if it switches automatically, and migrates
+// at most TIMER_MIGRATION_BATCH pending timers towards it
+void TimerThread::rebalance_impl()
+{
+    if (adaptive) {
+        std::size_t const pending = active.size();
+
+        if (QueueBackend::Tree == backend) {
+            if ((pending >= wheelAbove)
+                || ((pending >= treeBelow) && (cancelRatio > wheelCancelRatio)))
+            {
+                backend = QueueBackend::Wheel;
+            }
+        } else if ((pending < treeBelow)
+                    || ((pending < wheelAbove) && (cancelRatio < wheelCancelRatio / 2.0)))
+        {
+            backend = QueueBackend::Tree;
+        }
+    }
+
+    int budget = TIMER_MIGRATION_BATCH;
+
+    if (QueueBackend::Wheel == backend) {
+        // Move the latest timers of the queue into the wheel,
+        // until they are due too soon for it
+        auto i = queue.end();
+
+        while ((budget > 0) && (i != queue.begin())) {
+            --i;
+            --budget;
+
+            Timer &timer = *i;
+
+            if (timer.deferrable()) {
+                continue;
+            }
+
+            if (!wheelInsert_impl(timer)) {
+                break;
+            }
+
+            i = queue.erase(i);
+        }
+    } else {
+        // Move the timers of the wheel back into the
+        // queue, an empty slot counts as a timer
+        while ((budget > 0) && (wheelCount > 0U)) {
+            --budget;
+
+            Timer *timer = wheel[migrateSlot];
+
+            if (nullptr == timer) {
+                migrateSlot = (migrateSlot + 1U) % TIMER_WHEEL_SLOTS;
+                continue;
+            }
+
+            wheelRemove_impl(*timer);
+            timer->queuePos = queue.emplace(*timer);
+        }
+    }
+}
+
+// NOTE: called with statsSync held
+void TimerThread::unpublish_impl()
+{
+    ScopedLock lock(sync);
+    timer_id_t id = statsTimer;
+
+    statsTimer = no_timer;
+
+    lock.unlock();
+
+    // Synchronizes with the publishing timer,
+    // which closes its writer
+    if (no_timer != id) {
+        clearTimer(id);
+    }
+}
+
+// NOTE: called with the lock held. Timers in the tree, but the
+// one publishing the stats
+std::size_t TimerThread::activeSize_impl() const
+{
+    return active.size() - ((no_timer != statsTimer) ? 1U : 0U);
+}
+
+// NOTE: called by the publishing timer, or before it is created
+void TimerThread::publish_impl(TimerStatsWriter &writer, std::uint64_t pid)
+{
+    static_assert(TIMER_STATS_BUCKETS == TimerProfiler::buckets, "Histogram layouts differ");
+
+    TimerStatsData data;
+
+    std::memset(&data, 0, sizeof(data));
+
+    data.pid     = pid;
+    data.updated = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+
+    ScopedLock lock(sync);
+
+    data.updates        = ++statsUpdates;
+    data.pending        = activeSize_impl();
+    data.created        = createCount;
+    data.fired          = fireCount;
+    data.periodicFired  = periodicFireCount;
+    data.cancelled      = cancelCount;
+    data.deadlineMisses = missTotal;
+    data.backend        = static_cast<std::uint64_t>(backend);
+    data.wheelPending   = wheelCount;
+
+    if (profiler) {
+        data.profiling = 1U;
+        std::copy(profiler->delays().begin(), profiler->delays().end(), data.delays);
+        std::copy(profiler->firedLifetimes().begin(), profiler->firedLifetimes().end(), data.firedLifetimes);
+        std::copy(profiler->cancelledLifetimes().begin(), profiler->cancelledLifetimes().end(), data.cancelledLifetimes);
+    }
+
+    for (auto const &l : labels) {
+        if (TIMER_STATS_LABELS <= data.labelCount) {
+            break;
+        }
+
+        TimerStatsLabel &label = data.labels[data.labelCount++];
+
+        std::strncpy(label.name, l.first, TIMER_STATS_LABEL_SIZE - 1U);
+        label.fires       = l.second.fires;
+        label.nanoseconds = l.second.nanoseconds;
+    }
+
+    lock.unlock();
+
+    // Outside the lock, the page may be read by other processes
+    writer.write(data);
+}
+
 TimerThread &TimerThread::global()
 {
     static TimerThread singleton;
@@ -262,27 +1847,74 @@ TimerThread &TimerThread::global()
 // TimerThread::Timer implementation
 TimerThread::Timer::Timer(timer_id_t id)
     : id(id),
+    owner(nullptr),
+    slack(0),
+    missPolicy(MissPolicy::Fire),
+    misses(0U),
+    key(0U),
+    keyed(false),
+    detached(false),
+    lanePrev(nullptr),
+    laneNext(nullptr),
+    lane(-1),
+    label(nullptr),
+    wheelPrev(nullptr),
+    wheelNext(nullptr),
+    wheeled(false),
     running(false)
 {
 }
 
 TimerThread::Timer::Timer(Timer &&r) noexcept
     : id(std::move(r.id)),
+    owner(std::move(r.owner)),
     next(std::move(r.next)),
     period(std::move(r.period)),
+    slack(std::move(r.slack)),
     handler(std::move(r.handler)),
+    missHandler(std::move(r.missHandler)),
+    missPolicy(std::move(r.missPolicy)),
+    misses(std::move(r.misses)),
+    key(std::move(r.key)),
+    keyed(std::move(r.keyed)),
+    detached(std::move(r.detached)),
+    lanePrev(std::move(r.lanePrev)),
+    laneNext(std::move(r.laneNext)),
+    lane(std::move(r.lane)),
+    delay(std::move(r.delay)),
+    created(std::move(r.created)),
+    label(std::move(r.label)),
+    cancelFlag(std::move(r.cancelFlag)),
+    wheelPrev(std::move(r.wheelPrev)),
+    wheelNext(std::move(r.wheelNext)),
+    wheeled(std::move(r.wheeled)),
     running(std::move(r.running))
 {
 }
 
 TimerThread::Timer::Timer(timer_id_t   id,
+                            TimerThread &owner,
                             Timestamp    next,
                             Duration     period,
                             handler_type handler) noexcept
     : id(id),
+    owner(&owner),
     next(next),
     period(period),
+    slack(0),
     handler(std::move(handler)),
+    missPolicy(MissPolicy::Fire),
+    misses(0U),
+    key(0U),
+    keyed(false),
+    detached(false),
+    lanePrev(nullptr),
+    laneNext(nullptr),
+    lane(-1),
+    label(nullptr),
+    wheelPrev(nullptr),
+    wheelNext(nullptr),
+    wheeled(false),
     running(false)
 {
 }
@@ -0,0 +1,1544 @@
+/**
+ * TimerThread regression tests
+ *
+ * @file regression.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "TimerThread.hxx"
+#include "TimerDomain.hxx"
+#include "ExpiringMap.hxx"
+#include "IdleSweeper.hxx"
+#include "TimerBatch.hxx"
+#include "CyclicExecutive.hxx"
+#include "BatchAggregator.hxx"
+#include "TimerStats.hxx"
+#include "TimerFuture.hxx"
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <optional>
+
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+/* TimerThreadTest class definition -------------------- */
+/** @brief Reaches into TimerThread to set up the cases
+ * that can't be produced through its API
+ */
+class TimerThreadTest
+{
+    public:
+        /** @brief Cancelling a timer must not drop the
+         * other timers sharing its deadline
+         */
+        static bool equalDeadlines();
+
+        /** @brief After a switch from the ConcurrentWheel to the
+         * LocalHeaps backend, a claim posted while the worker goes
+         * through the wheel must still be served
+         */
+        static bool switchToLocalHeaps();
+
+        /** @brief The LocalHeaps slot of a producer thread is
+         * released when it exits, and its timers stay reachable
+         */
+        static bool releaseProducerSlots();
+
+        /** @brief The flat combining record of a thread is
+         * released when it exits
+         */
+        static bool releaseRequestRecords();
+
+        /** @brief A timer due before the tail of its lane goes to
+         * the tree, and the Wheel backend takes the lanes' timers
+         */
+        static bool laneFallback();
+
+        /** @brief The adaptive backend migrates the pending
+         * timers into the wheel, and back into the tree
+         */
+        static bool adaptiveMigration();
+};
+
+bool TimerThreadTest::equalDeadlines()
+{
+    TimerThread      lTimers;
+    std::atomic<int> lFired(0);
+    std::atomic<int> lCancelledFired(0);
+
+    auto lCount = [&lFired]() {
+        lFired.fetch_add(1);
+    };
+
+    TimerThread::timer_id_t const a = lTimers.setTimeout(lCount, 60 * 1000 * 1000);
+    TimerThread::timer_id_t const b = lTimers.setTimeout([&lCancelledFired]() {
+                                                            lCancelledFired.fetch_add(1);
+                                                        },
+                                                        60 * 1000 * 1000);
+    TimerThread::timer_id_t const c = lTimers.setTimeout(lCount, 60 * 1000 * 1000);
+
+    {
+        // Move the three timers to the exact same deadline
+        TimerThread::ScopedLock lock(lTimers.sync);
+        TimerThread::Timestamp  lDeadline = TimerThread::Clock::now() + std::chrono::milliseconds(20);
+
+        for (TimerThread::timer_id_t lId : {a, b, c}) {
+            TimerThread::Timer &lTimer = lTimers.active.find(lId)->second;
+
+            lTimers.dequeue_impl(lTimer);
+            lTimer.next = lDeadline;
+            lTimers.enqueue_impl(lTimer);
+        }
+    }
+
+    if (!lTimers.clearTimer(b)) {
+        std::cerr << "[ERROR] <equalDeadlines> clearTimer failed" << std::endl;
+        return false;
+    }
+
+    if (2U != lTimers.size()) {
+        std::cerr << "[ERROR] <equalDeadlines> " << lTimers.size() << " timers left instead of 2" << std::endl;
+        return false;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    if ((2 != lFired.load()) || (0 != lCancelledFired.load())) {
+        std::cerr << "[ERROR] <equalDeadlines> " << lFired.load() << " timers fired instead of 2, "
+                  << lCancelledFired.load() << " cancelled timers fired" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TimerThreadTest::switchToLocalHeaps()
+{
+    static std::size_t constexpr sCancelled = 300000U;
+
+    std::atomic<bool> lDone(false);
+    std::atomic<int>  lFailed(0);
+    std::thread       lTest([&lDone, &lFailed]() {
+                            TimerThread                          lTimers;
+                            std::atomic<TimerThread::timer_id_t> lForeign(TimerThread::no_timer);
+                            std::atomic<bool>                    lStop(false);
+
+                            lTimers.setQueueBackend(TimerThread::QueueBackend::ConcurrentWheel);
+
+                            // Cancelled timers leave their references in the wheel,
+                            // all in the same tick, so that the worker releases the
+                            // lock for a while when it goes through them
+                            TimerThread::Timestamp const lDue = TimerThread::Clock::now() + std::chrono::milliseconds(500);
+
+                            for (std::size_t i = 0U; i < sCancelled; ++i) {
+                                TimerThread::Submission lSubmission{lTimers.reserve_impl(), lDue, TimerThread::Duration(0),
+                                                                    TimerThread::Duration(0), []() {}};
+                                TimerThread::timer_id_t const lId = lSubmission.id;
+
+                                lTimers.staged.wheel->insert(lSubmission);
+                                lTimers.staged.wheel->take(lId, lSubmission);
+                            }
+
+                            lTimers.setQueueBackend(TimerThread::QueueBackend::LocalHeaps);
+
+                            std::thread lProducer([&lTimers, &lForeign, &lStop]() {
+                                                    while (!lStop.load()) {
+                                                        if (TimerThread::no_timer == lForeign.load()) {
+                                                            lForeign.store(lTimers.setTimeout([]() {}, 60 * 1000 * 1000));
+                                                        }
+
+                                                        std::this_thread::yield();
+                                                    }
+                                                });
+
+                            // Claim until well after the worker went through the wheel
+                            while (TimerThread::Clock::now() < lDue + std::chrono::milliseconds(300)) {
+                                TimerThread::timer_id_t const lId = lForeign.exchange(TimerThread::no_timer);
+
+                                if ((TimerThread::no_timer != lId) && !lTimers.clearTimer(lId)) {
+                                    lFailed.fetch_add(1);
+                                }
+
+                                std::this_thread::yield();
+                            }
+
+                            lStop.store(true);
+                            lProducer.join();
+                            lDone.store(true);
+                        });
+
+    for (int i = 0; (i < 500) && !lDone.load(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    if (!lDone.load()) {
+        // The claim can't return
+        std::cerr << "[ERROR] <switchToLocalHeaps> a claim is never served" << std::endl;
+        std::_Exit(EXIT_FAILURE);
+    }
+
+    lTest.join();
+
+    if (0 != lFailed.load()) {
+        std::cerr << "[ERROR] <switchToLocalHeaps> " << lFailed.load() << " clearTimer failed" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TimerThreadTest::releaseProducerSlots()
+{
+    TimerThread                          lTimers;
+    std::vector<TimerThread::timer_id_t> lIds;
+
+    lTimers.setQueueBackend(TimerThread::QueueBackend::LocalHeaps);
+
+    // More short-lived producers than there are slots
+    for (std::size_t t = 0U; t < 2U * TIMER_PRODUCER_SLOTS; ++t) {
+        std::thread lProducer([&lTimers, &lIds]() {
+                                    lIds.push_back(lTimers.setTimeout([]() {}, 60 * 1000 * 1000));
+                                });
+
+        lProducer.join();
+
+        if (0U != lTimers.staged.heaps->producers()) {
+            std::cerr << "[ERROR] <releaseProducerSlots> the slot of producer " << t << " was not released" << std::endl;
+            return false;
+        }
+    }
+
+    if (lIds.size() != lTimers.staged.heaps->size()) {
+        std::cerr << "[ERROR] <releaseProducerSlots> " << lTimers.staged.heaps->size() << " timers in the heaps instead of "
+                  << lIds.size() << std::endl;
+        return false;
+    }
+
+    // Claimed from the heaps of the exited threads
+    for (const TimerThread::timer_id_t &lId : lIds) {
+        if (!lTimers.clearTimer(lId)) {
+            std::cerr << "[ERROR] <releaseProducerSlots> timer " << lId << " of an exited producer was lost" << std::endl;
+            return false;
+        }
+    }
+
+    return 0U == lTimers.size();
+}
+
+bool TimerThreadTest::releaseRequestRecords()
+{
+    TimerThread lTimers;
+
+    lTimers.setFlatCombining(true);
+
+    // More short-lived threads than there are records
+    for (std::size_t t = 0U; t < 2U * TIMER_COMBINING_SLOTS; ++t) {
+        std::thread lThread([&lTimers]() {
+                                lTimers.clearTimer(lTimers.setTimeout([]() {}, 60 * 1000 * 1000));
+                            });
+
+        lThread.join();
+
+        for (std::size_t r = 0U; r < TIMER_COMBINING_SLOTS; ++r) {
+            if (std::thread::id() != lTimers.combiner.records[r].thread.load()) {
+                std::cerr << "[ERROR] <releaseRequestRecords> the record of thread " << t << " was not released" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return 0U == lTimers.size();
+}
+
+bool TimerThreadTest::laneFallback()
+{
+    TimerThread              lTimers;
+    std::mutex               lSync;
+    std::vector<std::string> lOrder;
+
+    auto lRecord = [&lSync, &lOrder](std::string const &pName) {
+        return [&lSync, &lOrder, pName]() {
+            std::lock_guard<std::mutex> lock(lSync);
+
+            lOrder.push_back(pName);
+        };
+    };
+
+    TimerThread::timer_id_t const a = lTimers.setTimeout(lRecord("a"), 50 * 1000);
+    TimerThread::timer_id_t const b = lTimers.setTimeout(lRecord("b"), 50 * 1000);
+
+    {
+        // Move b before a, the tail of their lane
+        TimerThread::ScopedLock lock(lTimers.sync);
+        TimerThread::Timer     &lA = lTimers.active.find(a)->second;
+        TimerThread::Timer     &lB = lTimers.active.find(b)->second;
+
+        lTimers.dequeue_impl(lB);
+        lB.next = lA.next - std::chrono::milliseconds(20);
+        lTimers.enqueue_impl(lB);
+
+        if ((0 > lA.lane) || (-1 != lB.lane)) {
+            std::cerr << "[ERROR] <laneFallback> a timer due before the tail of its lane went to lane "
+                      << lB.lane << std::endl;
+            return false;
+        }
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    {
+        std::lock_guard<std::mutex> lock(lSync);
+
+        if ((2U != lOrder.size()) || ("b" != lOrder[0U])) {
+            std::cerr << "[ERROR] <laneFallback> the timer moved out of the lane did not fire first" << std::endl;
+            return false;
+        }
+    }
+
+    lTimers.setQueueBackend(TimerThread::QueueBackend::Wheel);
+
+    TimerThread::timer_id_t const c = lTimers.setTimeout([]() {}, 50 * 1000);
+
+    {
+        TimerThread::ScopedLock lock(lTimers.sync);
+        TimerThread::Timer     &lC = lTimers.active.find(c)->second;
+
+        if ((-1 != lC.lane) || !lC.wheeled) {
+            std::cerr << "[ERROR] <laneFallback> the Wheel backend left a timer to lane " << lC.lane << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool TimerThreadTest::adaptiveMigration()
+{
+    TimerThread                          lTimers;
+    std::vector<TimerThread::timer_id_t> lIds;
+    std::atomic<int>                     lFired(0);
+
+    lTimers.setAdaptiveBackend(100U, 10U, 1.0);
+
+    // Distinct delays, so that most timers are not in a lane
+    for (int i = 0; i < 200; ++i) {
+        lIds.push_back(lTimers.setTimeout([&lFired]() {
+                                                lFired.fetch_add(1);
+                                            },
+                                            200 * 1000 + i * 100));
+    }
+
+    {
+        TimerThread::ScopedLock lock(lTimers.sync);
+
+        if ((TimerThread::QueueBackend::Wheel != lTimers.backend) || (0U != lTimers.queue.size())
+            || (0U == lTimers.wheelCount))
+        {
+            std::cerr << "[ERROR] <adaptiveMigration> " << lTimers.queue.size() << " timers left in the tree, "
+                      << lTimers.wheelCount << " in the wheel, after switching to it" << std::endl;
+            return false;
+        }
+    }
+
+    for (std::size_t i = 5U; i < lIds.size(); ++i) {
+        lTimers.clearTimer(lIds[i]);
+    }
+
+    if (TimerThread::QueueBackend::Tree != lTimers.queueBackend()) {
+        std::cerr << "[ERROR] <adaptiveMigration> still on the wheel with " << lTimers.size() << " timers" << std::endl;
+        return false;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    TimerThread::ScopedLock lock(lTimers.sync);
+
+    if ((5 != lFired.load()) || (0U != lTimers.wheelCount)) {
+        std::cerr << "[ERROR] <adaptiveMigration> " << lFired.load() << " timers fired instead of 5, "
+                  << lTimers.wheelCount << " left in the wheel" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/* Tests ----------------------------------------------- */
+// Timers created and cleared by concurrent producers through the
+// staging backend, or by flat combining, must fire once and on time,
+// or not at all. Half of the cleared timers are cleared by another thread
+static bool concurrentBackend(TimerThread::QueueBackend pBackend, const char *pName, bool pCombining = false)
+{
+    static std::size_t constexpr sProducers = 4U;
+    static std::size_t constexpr sTimers    = 500U;
+
+    TimerThread              lTimers;
+    std::atomic<std::size_t> lFired(0U);
+    std::atomic<std::size_t> lEarly(0U);
+    std::atomic<std::size_t> lFailed(0U);
+    std::vector<std::thread> lProducers;
+
+    std::vector<std::vector<TimerThread::timer_id_t>> lForeign(sProducers);
+
+    lTimers.setQueueBackend(pBackend);
+    lTimers.setFlatCombining(pCombining);
+
+    for (std::size_t p = 0U; p < sProducers; ++p) {
+        lProducers.emplace_back([&, p]() {
+                                    for (std::size_t i = 0U; i < sTimers; ++i) {
+                                        auto const lDue = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+
+                                        lTimers.setTimeout([&lFired, &lEarly, lDue]() {
+                                                                if (std::chrono::steady_clock::now() < lDue) {
+                                                                    lEarly.fetch_add(1U);
+                                                                }
+
+                                                                lFired.fetch_add(1U);
+                                                            },
+                                                            20 * 1000);
+
+                                        TimerThread::timer_id_t const lId = lTimers.setTimeout([&lFired]() {
+                                                                                                    lFired.fetch_add(1000U);
+                                                                                                },
+                                                                                                60 * 1000 * 1000);
+
+                                        if (0U != (i % 2U)) {
+                                            lForeign[p].push_back(lId);
+                                        } else if (!lTimers.clearTimer(lId)) {
+                                            lFailed.fetch_add(1U);
+                                        }
+                                    }
+                                });
+    }
+
+    for (std::thread &lProducer : lProducers) {
+        lProducer.join();
+    }
+
+    for (std::vector<TimerThread::timer_id_t> const &lIds : lForeign) {
+        for (TimerThread::timer_id_t const &lId : lIds) {
+            if (!lTimers.clearTimer(lId)) {
+                lFailed.fetch_add(1U);
+            }
+        }
+    }
+
+    // Leave time to the slowest machines
+    for (int i = 0; (i < 100) && (lFired.load() < sProducers * sTimers); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    if ((sProducers * sTimers != lFired.load()) || (0U != lEarly.load()) || (0U != lFailed.load())) {
+        std::cerr << "[ERROR] <" << pName << "> " << lFired.load() << " fired instead of " << sProducers * sTimers
+                  << ", " << lEarly.load() << " early, " << lFailed.load() << " clearTimer failed" << std::endl;
+        return false;
+    }
+
+    if (!lTimers.empty()) {
+        std::cerr << "[ERROR] <" << pName << "> " << lTimers.size() << " timers left" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// The timers created by a running handler are counted and cleared
+// like the others, and only their own IDs wait for the handler
+static bool pendingTimers()
+{
+    TimerDomain       lDomain(1U);
+    TimerThread       lHandlers(lDomain);
+    TimerThread       lTimers(lDomain);
+    std::atomic<int>  lStage(0);
+    std::atomic<int>  lFired(0);
+
+    lHandlers.setTimeout([&]() {
+                            lTimers.setTimeout([&lFired]() {
+                                                    lFired.fetch_add(1);
+                                                },
+                                                0);
+                            lStage.store(1);
+
+                            // Bounded, a clearTimer waiting for it would take that long
+                            for (int i = 0; (i < 200) && (2 != lStage.load()); ++i) {
+                                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                            }
+                        },
+                        0);
+
+    while (1 != lStage.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto const lStart   = std::chrono::steady_clock::now();
+    bool const lCleared = lTimers.clearTimer(987654321U);
+    auto const lElapsed = std::chrono::steady_clock::now() - lStart;
+    std::size_t const lSize = lTimers.size();
+
+    lTimers.clear();
+
+    std::size_t const lCleanSize = lTimers.size();
+
+    lStage.store(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    if (lCleared || (lElapsed > std::chrono::milliseconds(500))) {
+        std::cerr << "[ERROR] <pendingTimers> clearing an unknown ID waited for the handler" << std::endl;
+        return false;
+    }
+
+    if ((1U != lSize) || (0U != lCleanSize) || (0 != lFired.load())) {
+        std::cerr << "[ERROR] <pendingTimers> " << lSize << " timers before clear instead of 1, "
+                  << lCleanSize << " after, " << lFired.load() << " fired" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// With the LocalHeaps backend, clearing an ID that is in none of
+// the heaps must not wait for the worker, which runs a handler
+static bool localHeapsMiss()
+{
+    TimerThread             lTimers;
+    std::atomic<bool>       lRunning(false);
+    TimerThread::timer_id_t lForeign = TimerThread::no_timer;
+
+    lTimers.setQueueBackend(TimerThread::QueueBackend::LocalHeaps);
+
+    std::thread([&lTimers, &lForeign]() {
+                    lForeign = lTimers.setTimeout([]() {}, 60 * 1000 * 1000);
+                }).join();
+
+    lTimers.setTimeout([&lRunning]() {
+                            lRunning.store(true);
+                            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                        },
+                        0);
+
+    while (!lRunning.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto const lStart   = std::chrono::steady_clock::now();
+    bool const lCleared = lTimers.clearTimer(987654321U);
+    auto const lElapsed = std::chrono::steady_clock::now() - lStart;
+
+    if (lCleared || (lElapsed > std::chrono::milliseconds(250))) {
+        std::cerr << "[ERROR] <localHeapsMiss> clearing an unknown ID waited for the worker" << std::endl;
+        return false;
+    }
+
+    if (!lTimers.clearTimer(lForeign)) {
+        std::cerr << "[ERROR] <localHeapsMiss> clearing the timer of another thread failed" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Destroying a TimerThread must stop the worker, even when the
+// destructor notifies it while it released the lock for a claim
+static bool destroyAfterClaim()
+{
+    std::atomic<bool> lDone(false);
+    std::thread       lTest([&lDone]() {
+                            for (int i = 0; i < 10; ++i) {
+                                TimerThread lTimers;
+
+                                lTimers.setQueueBackend(TimerThread::QueueBackend::LocalHeaps);
+                                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                                lTimers.clearTimer(987654321U);
+                            }
+
+                            lDone.store(true);
+                        });
+
+    for (int i = 0; (i < 250) && !lDone.load(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    if (!lDone.load()) {
+        // The worker can't be joined
+        std::cerr << "[ERROR] <destroyAfterClaim> the destructor hangs" << std::endl;
+        std::_Exit(EXIT_FAILURE);
+    }
+
+    lTest.join();
+
+    return true;
+}
+
+// An ExpiringMap entry whose deadline is moved earlier, by insert()
+// or touch(), must expire by then, not when its former bucket is swept
+static bool expiringMapEarlier()
+{
+    TimerThread           lTimers;
+    std::atomic<int>      lExpired(0);
+    ExpiringMap<int, int> lMap(10 * 1000 * 1000, 10 * 1000, lTimers);
+
+    lMap.setExpiryHandler([&lExpired](int const &, int &) {
+                                lExpired.fetch_add(1);
+                            });
+
+    lMap.insert(1, 1);
+    lMap.insert(2, 2);
+    lMap.insert(1, 1, 20 * 1000);
+    lMap.touch(2, 20 * 1000);
+
+    for (int i = 0; (i < 100) && (2 != lExpired.load()); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    if ((2 != lExpired.load()) || !lMap.empty()) {
+        std::cerr << "[ERROR] <expiringMapEarlier> " << lExpired.load() << " entries expired instead of 2, "
+                  << lMap.size() << " left" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/* Main ------------------------------------------------ */
+static bool cancellableTimer()
+{
+    TimerThread       lTimers;
+    std::atomic<int>  lFired(0);
+    std::atomic<int>  lTicks(0);
+    auto              lFlag   = std::make_shared<std::atomic<bool>>(false);
+    auto              lPeriod = std::make_shared<std::atomic<bool>>(false);
+
+    lTimers.addCancellableTimer(20 * 1000, 0,
+                                [&lFired]() {
+                                    lFired.fetch_add(1);
+                                },
+                                lFlag);
+    lTimers.addCancellableTimer(0, 5 * 1000,
+                                [&lTicks]() {
+                                    lTicks.fetch_add(1);
+                                },
+                                lPeriod);
+
+    lFlag->store(true);
+
+    // Still queued until it comes due
+    std::size_t const lSize = lTimers.size();
+
+    while (0 == lTicks.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    lPeriod->store(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    int const lStopped = lTicks.load();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    if ((0 != lFired.load()) || (lStopped != lTicks.load())) {
+        std::cerr << "[ERROR] <cancellableTimer> handlers ran after their flag was set" << std::endl;
+        return false;
+    }
+
+    if ((2U != lSize) || (0U != lTimers.size())) {
+        std::cerr << "[ERROR] <cancellableTimer> " << lSize << " timers after the cancel instead of 2, "
+                  << lTimers.size() << " once due instead of 0" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// A clearTimer applied by another thread, through flat combining,
+// is done by the time it returns
+static bool combinedClear()
+{
+    TimerThread              lTimers;
+    std::atomic<int>         lFired(0);
+    std::atomic<int>         lErrors(0);
+    std::vector<std::thread> lThreads;
+
+    lTimers.setFlatCombining(true);
+
+    for (int t = 0; t < 4; ++t) {
+        lThreads.emplace_back([&]() {
+                                    for (int i = 0; i < 200; ++i) {
+                                        TimerThread::timer_id_t const lId = lTimers.setTimeout([&lFired]() {
+                                                                                                    lFired.fetch_add(1);
+                                                                                                },
+                                                                                                20 * 1000);
+
+                                        // Unknown once cleared
+                                        if (!lTimers.clearTimer(lId) || lTimers.setLabel(lId, "cleared")) {
+                                            lErrors.fetch_add(1);
+                                        }
+                                    }
+                                });
+    }
+
+    for (std::thread &lThread : lThreads) {
+        lThread.join();
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+
+    if ((0 != lErrors.load()) || (0 != lFired.load()) || (0U != lTimers.size())) {
+        std::cerr << "[ERROR] <combinedClear> " << lErrors.load() << " clears not applied on return, "
+                  << lFired.load() << " cleared timers fired, " << lTimers.size() << " left" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// A periodic timer whose first handler call runs over three releases.
+// With MissPolicy::Fire, the three missed releases fire back to back
+// once it completes, with MissPolicy::Shed they are skipped
+static bool deadlineMiss(TimerThread::MissPolicy pPolicy, const char *pName, std::size_t pCatchUp)
+{
+    using Clock = std::chrono::steady_clock;
+
+    TimerThread                    lTimers;
+    std::mutex                     lSync;
+    std::vector<Clock::time_point> lStarts;
+    Clock::time_point              lCompleted;
+
+    std::atomic<TimerThread::timer_id_t> lMissed(TimerThread::no_timer);
+    std::atomic<TimerThread::time_us_t>  lLateness(0);
+
+    TimerThread::timer_id_t const lId = lTimers.setInterval([&]() {
+                                                                std::unique_lock<std::mutex> lock(lSync);
+
+                                                                lStarts.push_back(Clock::now());
+
+                                                                if (1U == lStarts.size()) {
+                                                                    lock.unlock();
+                                                                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                                                                    lock.lock();
+                                                                    lCompleted = Clock::now();
+                                                                }
+                                                            },
+                                                            30 * 1000);
+
+    lTimers.setMissHandler(lId,
+                            [&lMissed, &lLateness](TimerThread::timer_id_t pId, TimerThread::time_us_t pLateness) {
+                                // The calls catching up may be late too, by less
+                                lMissed.store(pId);
+                                lLateness.store(std::max(lLateness.load(), pLateness));
+                            },
+                            pPolicy);
+
+    for (int i = 0; i < 100; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        std::unique_lock<std::mutex> lock(lSync);
+
+        if (lStarts.size() >= pCatchUp + 2U) {
+            break;
+        }
+    }
+
+    std::uint64_t const lMisses = lTimers.deadlineMisses(lId);
+
+    lTimers.clearTimer(lId);
+
+    // Calls started right after the late one completed
+    std::size_t lCatchUp = 0U;
+
+    for (std::size_t i = 1U; i < lStarts.size(); ++i) {
+        if (lStarts[i] < lCompleted + std::chrono::milliseconds(10)) {
+            ++lCatchUp;
+        }
+    }
+
+    if ((lStarts.size() < pCatchUp + 2U) || (pCatchUp != lCatchUp)) {
+        std::cerr << "[ERROR] <deadlineMiss> " << pName << " fired " << lCatchUp << " releases back to back instead of "
+                  << pCatchUp << ", out of " << lStarts.size() << " calls" << std::endl;
+        return false;
+    }
+
+    if ((lId != lMissed.load()) || (lLateness.load() < 50 * 1000) || (1U > lMisses)) {
+        std::cerr << "[ERROR] <deadlineMiss> " << pName << " miss handler called for " << lMissed.load()
+                  << " instead of " << lId << ", " << lLateness.load() << " us late, "
+                  << lMisses << " misses" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static bool upsertPolicies()
+{
+    TimerThread      lTimers;
+    std::atomic<int> lFirst(0);
+    std::atomic<int> lSecond(0);
+    std::atomic<int> lLatest(0);
+    auto             lCount = [](std::atomic<int> &pCounter) {
+                                    return [&pCounter]() {
+                                        pCounter.fetch_add(1);
+                                    };
+                                };
+
+    // KeepEarliest moves the timer earlier, with the new handler
+    TimerThread::timer_id_t const lEarliest = lTimers.upsertTimer(1U, 500 * 1000, 0, lCount(lFirst));
+    TimerThread::timer_id_t const lMoved    = lTimers.upsertTimer(1U, 20 * 1000, 0, lCount(lSecond),
+                                                                    TimerThread::UpsertPolicy::KeepEarliest);
+    TimerThread::timer_id_t const lKept     = lTimers.upsertTimer(1U, 400 * 1000, 0, lCount(lFirst),
+                                                                    TimerThread::UpsertPolicy::KeepEarliest);
+
+    // KeepLatest ignores an earlier request, and takes a later one
+    TimerThread::timer_id_t const lLatestId = lTimers.upsertTimer(2U, 20 * 1000, 0, lCount(lLatest));
+    TimerThread::timer_id_t const lIgnored  = lTimers.upsertTimer(2U, 5 * 1000, 0, lCount(lFirst),
+                                                                    TimerThread::UpsertPolicy::KeepLatest);
+    TimerThread::timer_id_t const lDelayed  = lTimers.upsertTimer(2U, 80 * 1000, 0, lCount(lLatest),
+                                                                    TimerThread::UpsertPolicy::KeepLatest);
+
+    if ((lEarliest != lMoved) || (lEarliest != lKept) || (lLatestId != lIgnored) || (lLatestId != lDelayed)) {
+        std::cerr << "[ERROR] <upsertPolicies> an upsert changed the ID of the key's timer" << std::endl;
+        return false;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    int const lEarly = lLatest.load();
+
+    if ((1 != lSecond.load()) || (0 != lEarly) || (TimerThread::no_timer != lTimers.keyedTimer(1U))) {
+        std::cerr << "[ERROR] <upsertPolicies> KeepEarliest fired " << lSecond.load() << " times instead of 1, "
+                  << "KeepLatest fired " << lEarly << " times before its latest deadline" << std::endl;
+        return false;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+
+    if ((1 != lLatest.load()) || (0 != lFirst.load()) || (0U != lTimers.size())) {
+        std::cerr << "[ERROR] <upsertPolicies> KeepLatest fired " << lLatest.load() << " times instead of 1, "
+                  << "the losing handlers " << lFirst.load() << " times" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// An upsert racing the handler of the key's timer creates a
+// new timer for the key, and the running one is not rescheduled
+static bool upsertWhileRunning()
+{
+    TimerThread       lTimers;
+    std::atomic<int>  lRunning(0);
+    std::atomic<bool> lRelease(false);
+    std::atomic<int>  lFired(0);
+
+    TimerThread::timer_id_t const lFirst = lTimers.upsertTimer(7U, 0, 20 * 1000, [&]() {
+                                                                    lRunning.fetch_add(1);
+
+                                                                    while (!lRelease.load()) {
+                                                                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                                                                    }
+                                                                });
+
+    while (0 == lRunning.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    TimerThread::timer_id_t const lSecond = lTimers.upsertTimer(7U, 10 * 1000, 0, [&lFired]() {
+                                                                    lFired.fetch_add(1);
+                                                                },
+                                                                TimerThread::UpsertPolicy::KeepEarliest);
+    TimerThread::timer_id_t const lKeyed = lTimers.keyedTimer(7U);
+
+    lRelease.store(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+
+    if ((lFirst == lSecond) || (lSecond != lKeyed)) {
+        std::cerr << "[ERROR] <upsertWhileRunning> the key maps to " << lKeyed << ", the upsert returned "
+                  << lSecond << ", the running timer is " << lFirst << std::endl;
+        return false;
+    }
+
+    if ((1 != lFired.load()) || (1 != lRunning.load()) || (0U != lTimers.size())) {
+        std::cerr << "[ERROR] <upsertWhileRunning> the new timer fired " << lFired.load() << " times instead of 1, "
+                  << "the detached one " << lRunning.load() << " times, " << lTimers.size() << " timers left" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// A deferrable timer does not wake the worker before its slack, but
+// fires as soon as the worker is awake for another timer
+static bool deferrableTimer()
+{
+    TimerThread      lTimers;
+    std::atomic<int> lAlone(0);
+    std::atomic<int> lWoken(0);
+    std::atomic<int> lWaker(0);
+
+    lTimers.addDeferrableTimer(10 * 1000, 0, 100 * 1000, [&lAlone]() {
+                                                                lAlone.fetch_add(1);
+                                                            });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+
+    int const lEarly = lAlone.load();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(90));
+
+    if ((0 != lEarly) || (1 != lAlone.load())) {
+        std::cerr << "[ERROR] <deferrableTimer> fired " << lEarly << " times within its slack, "
+                  << lAlone.load() << " times after it" << std::endl;
+        return false;
+    }
+
+    lTimers.addDeferrableTimer(10 * 1000, 0, 10 * 1000 * 1000, [&lWoken]() {
+                                                                    lWoken.fetch_add(1);
+                                                                });
+    lTimers.setTimeout([&lWaker]() {
+                            lWaker.fetch_add(1);
+                        },
+                        40 * 1000);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    if ((1 != lWaker.load()) || (1 != lWoken.load())) {
+        std::cerr << "[ERROR] <deferrableTimer> fired " << lWoken.load()
+                  << " times when the worker woke up for another timer, instead of 1" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static bool timerBatch()
+{
+    TimerThread      lTimers;
+    std::atomic<int> lFired(0);
+    auto             lCount = [&lFired]() {
+                                    lFired.fetch_add(1);
+                                };
+
+    {
+        // Added then cleared before the flush
+        TimerBatch                    lBatch(0U, 0, lTimers);
+        TimerThread::timer_id_t const lId = lBatch.setTimeout(lCount, 10 * 1000);
+
+        if (!lBatch.clearTimer(lId) || !lBatch.empty()) {
+            std::cerr << "[ERROR] <timerBatch> a timer cleared before the flush was not dropped" << std::endl;
+            return false;
+        }
+
+        // Flushed, then cleared by the next flush
+        TimerThread::timer_id_t const lFlushed = lBatch.setTimeout(lCount, 10 * 1000);
+
+        lBatch.flush();
+
+        if (lBatch.clearTimer(lFlushed) || (1U != lTimers.size())) {
+            std::cerr << "[ERROR] <timerBatch> " << lTimers.size() << " timers after the flush instead of 1" << std::endl;
+            return false;
+        }
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    if ((0 != lFired.load()) || (0U != lTimers.size())) {
+        std::cerr << "[ERROR] <timerBatch> " << lFired.load() << " cleared timers fired" << std::endl;
+        return false;
+    }
+
+    {
+        // Flushed once 3 operations are buffered
+        TimerBatch lBatch(3U, 0, lTimers);
+
+        lBatch.setTimeout(lCount, 60 * 1000 * 1000);
+        lBatch.setTimeout(lCount, 60 * 1000 * 1000);
+
+        std::size_t const lBefore = lTimers.size();
+
+        lBatch.setTimeout(lCount, 60 * 1000 * 1000);
+
+        if ((0U != lBefore) || (3U != lTimers.size()) || !lBatch.empty()) {
+            std::cerr << "[ERROR] <timerBatch> maxOps flushed " << lBefore << " timers early, "
+                      << lTimers.size() << " on the third one" << std::endl;
+            return false;
+        }
+    }
+
+    lTimers.clear();
+
+    {
+        // Flushed when an operation comes 10 ms after the oldest one,
+        // never by age alone
+        TimerBatch lBatch(0U, 10 * 1000, lTimers);
+
+        lBatch.setTimeout(lCount, 60 * 1000 * 1000);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        std::size_t const lAlone = lTimers.size();
+
+        lBatch.setTimeout(lCount, 60 * 1000 * 1000);
+
+        if ((0U != lAlone) || (2U != lTimers.size()) || !lBatch.empty()) {
+            std::cerr << "[ERROR] <timerBatch> maxAge flushed " << lAlone << " lone timers, "
+                      << lTimers.size() << " on the next one" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool cyclicExecutive()
+{
+    CyclicExecutive lExecutive;
+    std::mutex      lSync;
+    std::string     lSequence;
+
+    auto lRecord = [&lSync, &lSequence](char pTask) {
+        return [&lSync, &lSequence, pTask]() {
+            std::lock_guard<std::mutex> lock(lSync);
+
+            lSequence.push_back(pTask);
+        };
+    };
+
+    // Registered out of rate-monotonic order
+    lExecutive.addTask(lRecord('C'), 20 * 1000);
+    lExecutive.addTask(lRecord('A'), 5 * 1000);
+    lExecutive.addTask(lRecord('B'), 10 * 1000);
+
+    if (0 != lExecutive.start()) {
+        std::cerr << "[ERROR] <cyclicExecutive> start failed" << std::endl;
+        return false;
+    }
+
+    if ((5 * 1000 != lExecutive.minorFrame()) || (20 * 1000 != lExecutive.majorFrame())
+        || (4U != lExecutive.frameCount()))
+    {
+        lExecutive.stop();
+        std::cerr << "[ERROR] <cyclicExecutive> " << lExecutive.frameCount() << " frames of "
+                  << lExecutive.minorFrame() << " us in " << lExecutive.majorFrame() << " us" << std::endl;
+        return false;
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        std::lock_guard<std::mutex> lock(lSync);
+
+        if (lSequence.size() >= 14U) {
+            break;
+        }
+    }
+
+    lExecutive.stop();
+
+    if (lSequence.size() < 14U) {
+        std::cerr << "[ERROR] <cyclicExecutive> only ran " << lSequence << std::endl;
+        return false;
+    }
+
+    // Frames of the major frame: ABC, A, AB, A
+    std::string const lFrames = "ABCAABA";
+
+    for (std::size_t i = 0U; i < lSequence.size(); ++i) {
+        if (lFrames[i % lFrames.size()] != lSequence[i]) {
+            std::cerr << "[ERROR] <cyclicExecutive> ran " << lSequence << " instead of repeating " << lFrames << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool batchAggregator()
+{
+    TimerThread                   lTimers;
+    std::mutex                    lSync;
+    std::vector<std::vector<int>> lBatches;
+    BatchAggregator<int>          lAggregator(3U, 40 * 1000,
+                                                [&lSync, &lBatches](std::vector<int> &pBatch) {
+                                                    std::lock_guard<std::mutex> lock(lSync);
+
+                                                    lBatches.push_back(pBatch);
+                                                },
+                                                lTimers);
+
+    auto lFlushed = [&lSync, &lBatches]() {
+        std::lock_guard<std::mutex> lock(lSync);
+
+        return lBatches;
+    };
+
+    // Flushed on size, from the calling thread
+    lAggregator.add(1);
+    lAggregator.add(2);
+    lAggregator.add(3);
+
+    if ((1U != lFlushed().size()) || (std::vector<int>{1, 2, 3} != lFlushed().back())) {
+        std::cerr << "[ERROR] <batchAggregator> a full batch was not flushed on size" << std::endl;
+        return false;
+    }
+
+    // The timer armed for the first batch fires before the deadline
+    // of this one, it must rearm itself instead of flushing
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    lAggregator.add(4);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    std::size_t const lEarly = lFlushed().size();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    if ((1U != lEarly) || (2U != lFlushed().size()) || (std::vector<int>{4} != lFlushed().back())
+        || (0U != lAggregator.size()))
+    {
+        std::cerr << "[ERROR] <batchAggregator> " << (lEarly - 1U) << " batches flushed before their deadline, "
+                  << (lFlushed().size() - 1U) << " after it instead of 1" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Threads incrementing a counter under a TimerLock of each policy,
+// and a TimerThread using the policy, with timers still firing
+static bool lockPolicy(TimerLock::Policy pPolicy, const char *pName)
+{
+    TimerLock                lLock(pPolicy);
+    std::vector<std::thread> lThreads;
+    std::size_t              lCount = 0U;
+
+    for (int t = 0; t < 4; ++t) {
+        lThreads.emplace_back([&lLock, &lCount]() {
+                                    for (int i = 0; i < 20000; ++i) {
+                                        if ((0 == (i % 16)) && lLock.try_lock()) {
+                                            ++lCount;
+                                            lLock.unlock();
+                                            continue;
+                                        }
+
+                                        std::lock_guard<TimerLock> lock(lLock);
+
+                                        ++lCount;
+                                    }
+                                });
+    }
+
+    for (std::thread &lThread : lThreads) {
+        lThread.join();
+    }
+
+    if (4U * 20000U != lCount) {
+        std::cerr << "[ERROR] <lockPolicy> " << pName << " counted " << lCount << " instead of " << (4U * 20000U) << std::endl;
+        return false;
+    }
+
+    TimerThread      lTimers(pPolicy);
+    std::atomic<int> lFired(0);
+
+    lThreads.clear();
+
+    for (int t = 0; t < 4; ++t) {
+        lThreads.emplace_back([&lTimers, &lFired]() {
+                                    for (int i = 0; i < 2000; ++i) {
+                                        lTimers.clearTimer(lTimers.setTimeout([]() {}, 60 * 1000 * 1000));
+                                    }
+
+                                    lTimers.setTimeout([&lFired]() {
+                                                            lFired.fetch_add(1);
+                                                        },
+                                                        1000);
+                                });
+    }
+
+    for (std::thread &lThread : lThreads) {
+        lThread.join();
+    }
+
+    for (int i = 0; (i < 100) && (4 != lFired.load()); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    if ((4 != lFired.load()) || (0U != lTimers.size())) {
+        std::cerr << "[ERROR] <lockPolicy> " << pName << " fired " << lFired.load() << " timers instead of 4" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Histogram buckets of a TimerProfiler, recorded by hand, then
+// through a TimerThread
+static bool profilerHistograms()
+{
+    TimerProfiler lProfiler;
+
+    lProfiler.created(0, 0, 1U);
+    lProfiler.created(1, 0, 2U);
+    lProfiler.created(1000, 500, 3U);
+    lProfiler.created(1023, 0, 2U);
+    lProfiler.fired(3);
+    lProfiler.cancelled(1024);
+    lProfiler.reset();
+
+    // Bucket b holds 2^(b-1) <= v < 2^b, bucket 0 the zeros
+    if ((1U != lProfiler.delays()[0]) || (1U != lProfiler.delays()[1]) || (2U != lProfiler.delays()[10])
+        || (1U != lProfiler.firedLifetimes()[2]) || (1U != lProfiler.cancelledLifetimes()[11]))
+    {
+        std::cerr << "[ERROR] <profilerHistograms> values counted in the wrong buckets" << std::endl;
+        return false;
+    }
+
+    if ((4U != lProfiler.creations()) || (1U != lProfiler.periodics()) || (3U != lProfiler.peakPending())
+        || (0.5 != lProfiler.cancelRatio()) || (0.2 != lProfiler.resetRatio())
+        || (1024 != TimerProfiler::quantile(lProfiler.delays(), 1.0)) || (1 != TimerProfiler::quantile(lProfiler.delays(), 0.0)))
+    {
+        std::cerr << "[ERROR] <profilerHistograms> wrong counters or quantiles" << std::endl;
+        return false;
+    }
+
+    TimerThread lTimers;
+
+    if (lTimers.profile(lProfiler)) {
+        std::cerr << "[ERROR] <profilerHistograms> a profile was copied with the profiler disabled" << std::endl;
+        return false;
+    }
+
+    lTimers.enableProfiler();
+
+    // 10 ms lands in [8192, 16384) us
+    lTimers.setTimeout([]() {}, 10 * 1000);
+    lTimers.setTimeout([]() {}, 10 * 1000);
+    lTimers.clearTimer(lTimers.setTimeout([]() {}, 10 * 1000));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    if (!lTimers.profile(lProfiler)) {
+        std::cerr << "[ERROR] <profilerHistograms> the profile was not copied" << std::endl;
+        return false;
+    }
+
+    // Fired 10 ms or more after their creation
+    std::uint64_t lOnTime = 0U;
+
+    for (std::size_t b = 14U; b < TimerProfiler::buckets; ++b) {
+        lOnTime += lProfiler.firedLifetimes()[b];
+    }
+
+    if ((3U != lProfiler.creations()) || (3U != lProfiler.delays()[14]) || (2U != lProfiler.fires())
+        || (2U != lOnTime) || (1U != lProfiler.cancels()))
+    {
+        std::cerr << "[ERROR] <profilerHistograms> " << lProfiler.creations() << " creations, "
+                  << lProfiler.fires() << " fires and " << lProfiler.cancels() << " cancels instead of 3, 2 and 1" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Calls and handler time of labelled timers, as labelStats reports them
+static bool timerLabels()
+{
+    static const char sSlow[] = "slow";
+    static const char sTick[] = "tick";
+
+    TimerThread lTimers;
+
+    TimerThread::timer_id_t const lSlow = lTimers.setTimeout([]() {
+                                                                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                                                            },
+                                                            20 * 1000);
+    TimerThread::timer_id_t const lTick = lTimers.setInterval([]() {}, 10 * 1000);
+    TimerThread::timer_id_t const lNone = lTimers.setTimeout([]() {}, 20 * 1000);
+
+    if (!lTimers.setLabel(lSlow, sSlow) || !lTimers.setLabel(lTick, sTick) || lTimers.setLabel(TimerThread::no_timer, sTick)
+        || (sSlow != lTimers.label(lSlow)) || (nullptr != lTimers.label(lNone)))
+    {
+        std::cerr << "[ERROR] <timerLabels> labels were not attached to their timers" << std::endl;
+        return false;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(55));
+    lTimers.clearTimer(lTick);
+
+    TimerThread::LabelStats lSlowStats{0U, 0U};
+    TimerThread::LabelStats lTickStats{0U, 0U};
+    std::size_t             lCount = 0U;
+
+    // Labels are compared by address
+    for (auto const &l : lTimers.labelStats()) {
+        ++lCount;
+
+        if (sSlow == l.first) {
+            lSlowStats = l.second;
+        } else if (sTick == l.first) {
+            lTickStats = l.second;
+        }
+    }
+
+    if ((2U != lCount) || (1U != lSlowStats.fires) || (lSlowStats.nanoseconds < 5U * 1000U * 1000U)
+        || (lTickStats.fires < 3U) || (lTickStats.fires > 6U))
+    {
+        std::cerr << "[ERROR] <timerLabels> " << lCount << " labels, " << lSlowStats.fires << " slow calls ("
+                  << lSlowStats.nanoseconds << " ns) and " << lTickStats.fires << " ticks" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// A TimerStatsReader only sees whole snapshots of a page rewritten
+// meanwhile, and the page a TimerThread publishes leaves its
+// publishing timer out, like size() and clear() do
+static bool statsPage()
+{
+    std::string const lPath = "/tmp/TimerThread-regression-" + std::to_string(getpid()) + ".stats";
+    TimerStatsWriter  lWriter;
+    TimerStatsReader  lReader;
+
+    if ((0 != lWriter.open(lPath.c_str())) || (0 != lReader.open(lPath.c_str()))) {
+        std::cerr << "[ERROR] <statsPage> failed to map " << lPath << std::endl;
+        return false;
+    }
+
+    std::atomic<bool> lStop(false);
+    std::thread       lUpdater([&lWriter, &lStop]() {
+                                    TimerStatsData lData;
+
+                                    std::memset(&lData, 0, sizeof(lData));
+
+                                    // Every field of a snapshot holds its update number
+                                    for (std::uint64_t u = 1U; !lStop.load(); ++u) {
+                                        lData.updates                                = u;
+                                        lData.created                                = u;
+                                        lData.delays[TIMER_STATS_BUCKETS - 1U]       = u;
+                                        lData.labels[TIMER_STATS_LABELS - 1U].fires = u;
+
+                                        lWriter.write(lData);
+                                        std::this_thread::yield();
+                                    }
+                                });
+
+    std::size_t lReads = 0U;
+    std::size_t lTorn  = 0U;
+
+    for (int i = 0; i < 20000; ++i) {
+        TimerStatsData lData;
+
+        if (0 == lReader.read(lData)) {
+            ++lReads;
+
+            if ((lData.updates != lData.created)
+                || (lData.updates != lData.delays[TIMER_STATS_BUCKETS - 1U])
+                || (lData.updates != lData.labels[TIMER_STATS_LABELS - 1U].fires))
+            {
+                ++lTorn;
+            }
+        }
+
+        std::this_thread::yield();
+    }
+
+    lStop.store(true);
+    lUpdater.join();
+    lWriter.close();
+    lReader.close();
+
+    if ((0U == lReads) || (0U != lTorn)) {
+        std::cerr << "[ERROR] <statsPage> " << lTorn << " torn snapshots out of " << lReads << " reads" << std::endl;
+        return false;
+    }
+
+    TimerThread    lTimers;
+    TimerStatsData lData;
+
+    lTimers.setTimeout([]() {}, 60 * 1000 * 1000);
+    lTimers.setTimeout([]() {}, 60 * 1000 * 1000);
+
+    if ((0 != lTimers.publishStats(lPath.c_str(), 5 * 1000)) || (0 != lReader.open(lPath.c_str()))) {
+        std::cerr << "[ERROR] <statsPage> failed to publish to " << lPath << std::endl;
+        return false;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    bool const lPending = (0 == lReader.read(lData)) && (2U == lData.pending) && (2U == lTimers.size());
+
+    // The stats are still published once the other timers are cleared
+    lTimers.clear();
+
+    std::uint64_t const lUpdates = lData.updates;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    bool const lCleared = (0 == lReader.read(lData)) && (0U == lData.pending) && (lData.updates > lUpdates)
+                            && lTimers.empty();
+
+    lTimers.unpublishStats();
+    lReader.close();
+    unlink(lPath.c_str());
+
+    if (!lPending || !lCleared) {
+        std::cerr << "[ERROR] <statsPage> the publishing timer was counted, or cleared" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// An operation completing within its timeout, one completing too
+// late and a plain delay, with a continuation on each
+static bool timerFuture()
+{
+    TimerThread       lTimers;
+    std::thread       lLate;
+    std::atomic<int>  lContinued(0);
+    std::atomic<bool> lAbandoned(false);
+
+    TimerFuture<int> lQuick = withTimeout<int>([](TimerPromise<int> pPromise) {
+                                                    pPromise.set_value(42);
+                                                },
+                                                60 * 1000 * 1000,
+                                                lTimers);
+
+    TimerFuture<int> lSlow = withTimeout<int>([&lLate, &lAbandoned](TimerPromise<int> pPromise) {
+                                                    lLate = std::thread([pPromise, &lAbandoned]() mutable {
+                                                                            std::this_thread::sleep_for(std::chrono::milliseconds(60));
+                                                                            lAbandoned.store(pPromise.timedOut() && !pPromise.set_value(7));
+                                                                        });
+                                                },
+                                                20 * 1000,
+                                                lTimers);
+
+    TimerFuture<void> lDelay = after(10 * 1000, lTimers);
+
+    for (auto *lFuture : {&lQuick, &lSlow}) {
+        lFuture->then([&lContinued](TimerFutureStatus) {
+                            lContinued.fetch_add(1);
+                        });
+    }
+
+    // The quick one completed inline, its timeout is cancelled
+    std::optional<int> const lQuickValue = lQuick.get();
+
+    if ((TimerFutureStatus::Ready != lQuick.status()) || !lQuickValue || (42 != *lQuickValue)) {
+        std::cerr << "[ERROR] <timerFuture> the operation completed but its future is not ready" << std::endl;
+        lLate.join();
+        return false;
+    }
+
+    std::optional<int> const lSlowValue = lSlow.get();
+    bool const               lDelayed   = lDelay.get();
+
+    lLate.join();
+
+    if ((TimerFutureStatus::TimedOut != lSlow.status()) || lSlowValue || !lAbandoned.load()) {
+        std::cerr << "[ERROR] <timerFuture> the late operation did not time out" << std::endl;
+        return false;
+    }
+
+    if (!lDelayed || (2 != lContinued.load())) {
+        std::cerr << "[ERROR] <timerFuture> after() was not ready, or " << lContinued.load()
+                  << " continuations ran instead of 2" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static bool idleSweeper()
+{
+    TimerThread              lTimers;
+    std::vector<std::size_t> lExpired;
+
+    // Swept by hand only
+    IdleSweeper lSweeper(100U, 30 * 1000, 3600LL * 1000 * 1000,
+                            [&lExpired](IdleSweeper::slot_t pSlot) {
+                                lExpired.push_back(pSlot);
+                            },
+                            lTimers);
+
+    IdleSweeper::slot_t const lIdle   = lSweeper.open();
+    IdleSweeper::slot_t const lActive = lSweeper.open();
+    IdleSweeper::slot_t const lClosed = lSweeper.open();
+
+    if (!lSweeper.close(lClosed) || lSweeper.close(lClosed)) {
+        std::cerr << "[ERROR] <idleSweeper> a slot is not closed exactly once" << std::endl;
+        return false;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+
+    lSweeper.touch(lActive);
+    lSweeper.touch(IdleSweeper::no_slot);
+    lSweeper.sweep();
+
+    if ((1U != lExpired.size()) || (lIdle != lExpired.front()) || (1U != lSweeper.size())) {
+        std::cerr << "[ERROR] <idleSweeper> " << lExpired.size() << " slots expired instead of the idle one, "
+                  << lSweeper.size() << " left open" << std::endl;
+        return false;
+    }
+
+    // The expired slot is closed, touching it does not reopen it
+    lSweeper.touch(lIdle);
+    lSweeper.sweep();
+
+    if ((1U != lExpired.size()) || lSweeper.close(lIdle) || !lSweeper.close(lActive)) {
+        std::cerr << "[ERROR] <idleSweeper> an expired slot was reopened" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool lSuccess = true;
+
+    lSuccess = TimerThreadTest::equalDeadlines() && lSuccess;
+    lSuccess = concurrentBackend(TimerThread::QueueBackend::ConcurrentWheel, "concurrentWheel") && lSuccess;
+    lSuccess = concurrentBackend(TimerThread::QueueBackend::SkipList, "skipList") && lSuccess;
+    lSuccess = concurrentBackend(TimerThread::QueueBackend::MultiQueue, "multiQueue") && lSuccess;
+    lSuccess = concurrentBackend(TimerThread::QueueBackend::LocalHeaps, "localHeaps") && lSuccess;
+    lSuccess = concurrentBackend(TimerThread::QueueBackend::Tree, "flatCombining", true) && lSuccess;
+    lSuccess = pendingTimers() && lSuccess;
+    lSuccess = localHeapsMiss() && lSuccess;
+    lSuccess = TimerThreadTest::switchToLocalHeaps() && lSuccess;
+    lSuccess = TimerThreadTest::releaseProducerSlots() && lSuccess;
+    lSuccess = TimerThreadTest::releaseRequestRecords() && lSuccess;
+    lSuccess = TimerThreadTest::laneFallback() && lSuccess;
+    lSuccess = TimerThreadTest::adaptiveMigration() && lSuccess;
+    lSuccess = combinedClear() && lSuccess;
+    lSuccess = expiringMapEarlier() && lSuccess;
+    lSuccess = destroyAfterClaim() && lSuccess;
+    lSuccess = idleSweeper() && lSuccess;
+    lSuccess = cancellableTimer() && lSuccess;
+    lSuccess = deadlineMiss(TimerThread::MissPolicy::Fire, "fire", 3U) && lSuccess;
+    lSuccess = deadlineMiss(TimerThread::MissPolicy::Shed, "shed", 0U) && lSuccess;
+    lSuccess = upsertPolicies() && lSuccess;
+    lSuccess = upsertWhileRunning() && lSuccess;
+    lSuccess = deferrableTimer() && lSuccess;
+    lSuccess = timerBatch() && lSuccess;
+    lSuccess = cyclicExecutive() && lSuccess;
+    lSuccess = batchAggregator() && lSuccess;
+    lSuccess = lockPolicy(TimerLock::Policy::Blocking, "blocking") && lSuccess;
+    lSuccess = lockPolicy(TimerLock::Policy::AdaptiveSpin, "adaptiveSpin") && lSuccess;
+    lSuccess = lockPolicy(TimerLock::Policy::PriorityInheritance, "priorityInheritance") && lSuccess;
+    lSuccess = profilerHistograms() && lSuccess;
+    lSuccess = timerLabels() && lSuccess;
+    lSuccess = statsPage() && lSuccess;
+    lSuccess = timerFuture() && lSuccess;
+
+    std::cout << (lSuccess ? "[PASS]" : "[FAIL]") << " TimerThread regression tests" << std::endl;
+
+    return lSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,117 @@
+/**
+ * TimerThread std::stop_token tests, built as C++20
+ *
+ * @file stoptoken.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "TimerThread.hxx"
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stop_token>
+
+#include <cstdlib>
+
+#if !defined(__cpp_lib_jthread)
+#error "The std::stop_token overload of addTimer needs __cpp_lib_jthread"
+#endif /* __cpp_lib_jthread */
+
+/* Tests ----------------------------------------------- */
+static bool stopBeforeDue()
+{
+    TimerThread       lTimers;
+    std::stop_source  lSource;
+    std::atomic<int>  lFired(0);
+
+    TimerThread::timer_id_t const lId = lTimers.addTimer(20 * 1000, 0,
+                                                            [&lFired]() {
+                                                                lFired.fetch_add(1);
+                                                            },
+                                                            lSource.get_token());
+
+    lSource.request_stop();
+
+    // The cancelled timer stays queued until it comes due
+    std::size_t const lSize = lTimers.size();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+
+    if ((TimerThread::no_timer == lId) || (0 != lFired.load())) {
+        std::cerr << "[ERROR] <stopBeforeDue> the handler ran " << lFired.load() << " times after the stop" << std::endl;
+        return false;
+    }
+
+    if ((1U != lSize) || (0U != lTimers.size())) {
+        std::cerr << "[ERROR] <stopBeforeDue> " << lSize << " timers after the stop instead of 1, "
+                  << lTimers.size() << " once due instead of 0" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static bool stopPeriodic()
+{
+    TimerThread       lTimers;
+    std::stop_source  lSource;
+    std::atomic<int>  lFired(0);
+
+    lTimers.addTimer(0, 5 * 1000,
+                        [&lFired]() {
+                            lFired.fetch_add(1);
+                        },
+                        lSource.get_token());
+
+    while (0 == lFired.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    lSource.request_stop();
+
+    // A handler may have been running while the stop was requested
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    int const lStopped = lFired.load();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    if ((lStopped != lFired.load()) || (0U != lTimers.size())) {
+        std::cerr << "[ERROR] <stopPeriodic> the handler ran " << (lFired.load() - lStopped) << " times after the stop, "
+                  << lTimers.size() << " timers left" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static bool alreadyStopped()
+{
+    TimerThread      lTimers;
+    std::stop_source lSource;
+
+    lSource.request_stop();
+
+    if (TimerThread::no_timer != lTimers.addTimer(0, 0, []() {}, lSource.get_token())) {
+        std::cerr << "[ERROR] <alreadyStopped> a timer was created with a stopped token" << std::endl;
+        return false;
+    }
+
+    return 0U == lTimers.size();
+}
+
+/* Main ------------------------------------------------ */
+int main()
+{
+    bool lSuccess = true;
+
+    lSuccess = stopBeforeDue() && lSuccess;
+    lSuccess = stopPeriodic() && lSuccess;
+    lSuccess = alreadyStopped() && lSuccess;
+
+    std::cout << (lSuccess ? "[PASS]" : "[FAIL]") << " TimerThread stop_token tests" << std::endl;
+
+    return lSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+}
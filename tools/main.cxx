@@ -0,0 +1,124 @@
+/**
+ * TimerThread stats page reader
+ *
+ * @file main.cxx
+ */
+
+/* Includes -------------------------------------------- */
+#include "TimerStats.hxx"
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+
+#include <cstring>
+#include <cstdlib>
+
+/* Report ---------------------------------------------- */
+static const char *backendName(const std::uint64_t &pBackend)
+{
+    switch (pBackend) {
+        case 0U:
+            return "tree";
+        case 1U:
+            return "wheel";
+        default:
+            return "unknown";
+    }
+}
+
+static void printHistogram(const char *pTitle, const std::uint64_t * const pHistogram)
+{
+    std::cout << pTitle << std::endl;
+
+    for (std::size_t b = 0U; b < TIMER_STATS_BUCKETS; ++b) {
+        if (0U == pHistogram[b]) {
+            continue;
+        }
+
+        std::uint64_t const lLow = (0U == b) ? 0U : (1ULL << (b - 1U));
+
+        std::cout << "  >= " << std::setw(12) << lLow << " us : " << pHistogram[b] << std::endl;
+    }
+}
+
+static void print(const TimerStatsData &pData)
+{
+    std::cout << "pid             : " << pData.pid << std::endl
+              << "updates         : " << pData.updates << std::endl
+              << "updated         : " << pData.updated << " us" << std::endl
+              << "pending         : " << pData.pending << std::endl
+              << "created         : " << pData.created << std::endl
+              << "fired           : " << pData.fired << std::endl
+              << "periodic fired  : " << pData.periodicFired << std::endl
+              << "cancelled       : " << pData.cancelled << std::endl
+              << "deadline misses : " << pData.deadlineMisses << std::endl
+              << "backend         : " << backendName(pData.backend) << std::endl
+              << "wheel pending   : " << pData.wheelPending << std::endl;
+
+    if (0U != pData.profiling) {
+        printHistogram("delays", pData.delays);
+        printHistogram("lifetimes before fire", pData.firedLifetimes);
+        printHistogram("lifetimes before cancel", pData.cancelledLifetimes);
+    }
+
+    for (std::uint64_t i = 0U; (i < pData.labelCount) && (i < TIMER_STATS_LABELS); ++i) {
+        const TimerStatsLabel &lLabel = pData.labels[i];
+
+        std::cout << "label " << std::left << std::setw(TIMER_STATS_LABEL_SIZE) << lLabel.name
+                  << std::right << " fires " << std::setw(12) << lLabel.fires
+                  << " ns " << std::setw(16) << lLabel.nanoseconds << std::endl;
+    }
+}
+
+static void usage(const char *pName)
+{
+    std::cout << "Usage : " << pName << " <stats file> [--watch <ms>]" << std::endl
+              << "  --watch Print the stats again every <ms> milliseconds" << std::endl;
+}
+
+/* Main ------------------------------------------------ */
+int main(const int argc, const char * const * const argv)
+{
+    const char   *lPath  = nullptr;
+    unsigned long lWatch = 0U;
+
+    for (int i = 1; i < argc; ++i) {
+        if ((0 == std::strcmp(argv[i], "--watch")) && (i + 1 < argc)) {
+            lWatch = std::strtoul(argv[++i], nullptr, 10);
+        } else if (nullptr == lPath) {
+            lPath = argv[i];
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (nullptr == lPath) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    TimerStatsReader lReader;
+    TimerStatsData   lData;
+
+    if (0 != lReader.open(lPath)) {
+        return EXIT_FAILURE;
+    }
+
+    do {
+        if (0 != lReader.read(lData)) {
+            return EXIT_FAILURE;
+        }
+
+        print(lData);
+
+        if (0U != lWatch) {
+            std::cout << std::endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds(lWatch));
+        }
+    } while (0U != lWatch);
+
+    return EXIT_SUCCESS;
+}